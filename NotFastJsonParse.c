@@ -17,7 +17,7 @@ jboolean parseNode(JNIEnv *env, jclass *jsonBeanClass, nfjson_string *key, nfjso
 	} else if (type == JSON_NUMBER) {
 		//
 		fieldID = (*env)->GetFieldID(env, *jsonBeanClass, key->s, "I");
-		jint num = (jint)nfjson_get_number(val);
+		jint num = (jint)nfjson_get_int64(val);
 		(*env)->SetIntField(env, *jsonBeanObject, fieldID, num);
 	} else if (type == JSON_STRING) {
 		fieldID = (*env)->GetFieldID(env, *jsonBeanClass, key->s, "Ljava/lang/String;");
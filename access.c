@@ -2,6 +2,8 @@
 #include"notfastjson.h"
 #include"access.h"
 #include"memory.h"
+#include"object.h"
+#include"parse.h"
 
 nfjson_type nfjson_get_type(const nfjson_value *val) {
     assert(val);
@@ -27,7 +29,11 @@ void nfjson_set_boolean(nfjson_value *val, int b) {
 
 double nfjson_get_number(const nfjson_value *val) {
     assert(val && val->type == JSON_NUMBER);
-    return val->u.n;
+    switch (val->ntype) {
+    case NFJSON_NUMBER_INT64: return (double)val->u.i;
+    case NFJSON_NUMBER_UINT64: return (double)val->u.ui;
+    default: return val->u.n;
+    }
 }
 
 void nfjson_set_number(nfjson_value *val, double n) {
@@ -35,6 +41,53 @@ void nfjson_set_number(nfjson_value *val, double n) {
     nfjson_free(val);
     val->u.n = n;
     val->type = JSON_NUMBER;
+    val->ntype = NFJSON_NUMBER_DOUBLE;
+}
+
+nfjson_number_type nfjson_get_number_type(const nfjson_value *val) {
+    assert(val && val->type == JSON_NUMBER);
+    return val->ntype;
+}
+
+int64_t nfjson_get_int64(const nfjson_value *val) {
+    assert(val && val->type == JSON_NUMBER);
+    switch (val->ntype) {
+    case NFJSON_NUMBER_INT64: return val->u.i;
+    case NFJSON_NUMBER_UINT64: return val->u.ui > INT64_MAX ? INT64_MAX : (int64_t)val->u.ui;
+    default://a double out of range or NaN has no defined cast
+        if (val->u.n != val->u.n) return 0;
+        if (val->u.n >= 9223372036854775808.0) return INT64_MAX;
+        if (val->u.n < -9223372036854775808.0) return INT64_MIN;
+        return (int64_t)val->u.n;
+    }
+}
+
+uint64_t nfjson_get_uint64(const nfjson_value *val) {
+    assert(val && val->type == JSON_NUMBER);
+    switch (val->ntype) {
+    case NFJSON_NUMBER_INT64: return val->u.i < 0 ? 0 : (uint64_t)val->u.i;
+    case NFJSON_NUMBER_UINT64: return val->u.ui;
+    default:
+        if (!(val->u.n > 0)) return 0;//NaN too
+        if (val->u.n >= 18446744073709551616.0) return UINT64_MAX;
+        return (uint64_t)val->u.n;
+    }
+}
+
+void nfjson_set_int64(nfjson_value *val, int64_t i) {
+    assert(val);
+    nfjson_free(val);
+    val->u.i = i;
+    val->type = JSON_NUMBER;
+    val->ntype = NFJSON_NUMBER_INT64;
+}
+
+void nfjson_set_uint64(nfjson_value *val, uint64_t ui) {
+    assert(val);
+    nfjson_free(val);
+    val->u.ui = ui;
+    val->type = JSON_NUMBER;
+    val->ntype = NFJSON_NUMBER_UINT64;
 }
 
 const char *nfjson_get_string(const nfjson_value *val) {
@@ -64,39 +117,54 @@ size_t nfjson_get_array_size(const nfjson_value *val) {
 
 nfjson_value *nfjson_get_array_element(const nfjson_value *val, size_t index) {
     assert(val && val->type == JSON_ARRAY);
-    if (index < val->u.a.len) return val->u.a.e + index;
+    if (index < val->u.a.len) return nfjson_lazy_resolve(val->u.a.e + index);
     return NULL;
 }
 
 size_t nfjson_get_object_size(nfjson_value *val) {
     assert(val && val->type == JSON_OBJECT);
-    return val->u.ht->cnt;
+    return val->u.o ? val->u.o->len : 0;
 }
 
 int nfjson_object_contains(nfjson_value *val, nfjson_string *key) {
     assert(val && val->type == JSON_OBJECT);
-    return hash_table_get(val->u.ht, (void *)key) != NULL;
+    return nfjson_object_find(val->u.o, key) != NULL;
+}
+
+nfjson_key nfjson_key_make(const char *s) {
+    return nfjson_key_make_n(s, strlen(s));
+}
+
+nfjson_key nfjson_key_make_n(const char *s, size_t len) {
+    nfjson_key key;
+    key.name.s = (char *)s;
+    key.name.len = len;
+    key.hash = hash_table_hash(s, len);//the hash of object indexes
+    key.pos = 0;
+    return key;
+}
+
+int nfjson_object_contains_key(nfjson_value *val, nfjson_key *key) {
+    assert(val && val->type == JSON_OBJECT);
+    return nfjson_object_find_key(val->u.o, key) != NULL;
 }
 
-size_t nfjson_get_object_key(nfjson_value *val, const nfjson_string **_keys) {
+nfjson_value *nfjson_get_object_value_by_key(nfjson_value *val, nfjson_key *key) {
+    assert(val && val->type == JSON_OBJECT);
+    nfjson_member *m = nfjson_object_find_key(val->u.o, key);
+    return m ? nfjson_lazy_resolve(&m->val) : NULL;
+}
+
+/* in input order */
+size_t nfjson_get_object_key(nfjson_value *val, const nfjson_string **keys) {
     assert(val->type == JSON_OBJECT);
-    nfjson_string **keys = (nfjson_string **)_keys;
-    size_t size = (size_t)val->u.ht->cnt, i = 0, cnt = 0;
-    kv **table = val->u.ht->table;
-    kv* kv_list = NULL;
-    while (cnt < size) {
-        if (kv_list = table[i]) {
-            while (kv_list) {
-                keys[cnt++] = (nfjson_string *)kv_list->key;
-                kv_list = kv_list->next;
-            }
-        }
-        i++;
-    }
-    return cnt;
+    size_t i, len = nfjson_get_object_size(val);
+    for (i = 0; i < len; i++) keys[i] = &val->u.o->m[i].key;
+    return len;
 }
 
 nfjson_value *nfjson_get_object_value(nfjson_value *val, nfjson_string *key) {
     assert(val && val->type == JSON_OBJECT);
-    return hash_table_get(val->u.ht, (void *)key);
+    nfjson_member *m = nfjson_object_find(val->u.o, key);
+    return m ? nfjson_lazy_resolve(&m->val) : NULL;
 }
\ No newline at end of file
@@ -13,6 +13,18 @@ double nfjson_get_number(const nfjson_value * val);
 
 void nfjson_set_number(nfjson_value * val, double n);
 
+nfjson_number_type nfjson_get_number_type(const nfjson_value * val);
+
+/* the fraction is dropped, a number out of range gives the nearest bound and NaN gives 0 */
+int64_t nfjson_get_int64(const nfjson_value * val);
+
+uint64_t nfjson_get_uint64(const nfjson_value * val);
+
+void nfjson_set_int64(nfjson_value * val, int64_t i);
+
+void nfjson_set_uint64(nfjson_value * val, uint64_t ui);
+
+/* '\0' terminated, except for text borrowed from the json by nfjson_parse_document_borrowed */
 const char * nfjson_get_string(const nfjson_value * val);
 
 size_t nfjson_get_string_length(const nfjson_value * val);
@@ -27,6 +39,20 @@ size_t nfjson_get_object_size(nfjson_value * val);
 
 int nfjson_object_contains(nfjson_value * val, nfjson_string * key);
 
+/**
+*   lookups on a value from nfjson_parse may build its hash index, see
+*   object.h, so they need a lock when threads share it. documents are not
+*   changed by lookups other than lazy decoding
+**/
 nfjson_value * nfjson_get_object_value(nfjson_value * val, nfjson_string * key);
 
+/* s is borrowed, keep it while the key is used */
+nfjson_key nfjson_key_make(const char *s);
+
+nfjson_key nfjson_key_make_n(const char *s, size_t len);
+
+int nfjson_object_contains_key(nfjson_value *val, nfjson_key *key);
+
+nfjson_value *nfjson_get_object_value_by_key(nfjson_value *val, nfjson_key *key);
+
 size_t nfjson_get_object_key(nfjson_value *val, const nfjson_string **_keys);
@@ -0,0 +1,84 @@
+#include"pch.h"
+#include"file.h"
+#include"parse.h"
+#if defined(_WIN32)
+#include<windows.h>
+#else
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#endif
+
+#if defined(_WIN32)
+int nfjson_file_map(nfjson_file *f, const char *path) {
+    HANDLE file, mapping;
+    LARGE_INTEGER size;
+    SYSTEM_INFO info;
+    size_t tail;
+    memset(f, 0, sizeof(nfjson_file));
+    f->data = "";
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return -1;
+    if (!GetFileSizeEx(file, &size)) { CloseHandle(file); return -1; }
+    if (size.QuadPart == 0) { CloseHandle(file); return 0; }
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);//the mapping keeps the file open
+    if (mapping == NULL) return -1;
+    f->base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (f->base == NULL) { CloseHandle(mapping); return -1; }
+    f->handle = mapping;
+    f->data = (const char *)f->base;
+    f->len = f->size = (size_t)size.QuadPart;
+    //a view ends with the file, only the zeroed rest of its last page can be read past it
+    GetSystemInfo(&info);
+    tail = f->len % info.dwPageSize;
+    if (tail && tail + NFJSON_PADDING <= info.dwPageSize) f->padding = NFJSON_PADDING;
+    return 0;
+}
+
+void nfjson_file_unmap(nfjson_file *f) {
+    if (f->base) UnmapViewOfFile(f->base);
+    if (f->handle) CloseHandle((HANDLE)f->handle);
+    memset(f, 0, sizeof(nfjson_file));
+}
+#else
+int nfjson_file_map(nfjson_file *f, const char *path) {
+    struct stat st;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE), size;
+    void *base;
+    int fd;
+    memset(f, 0, sizeof(nfjson_file));
+    f->data = "";
+    if ((fd = open(path, O_RDONLY)) < 0) return -1;
+    if (fstat(fd, &st) != 0) { close(fd); return -1; }
+    if (st.st_size == 0) { close(fd); return 0; }
+    /**
+    *   reserve one page more than the file and map the file over the front,
+    *   the zero page behind it makes the padding. reading past the last page
+    *   of a file mapping would fault
+    **/
+    size = ((size_t)st.st_size + page - 1) / page * page + page;
+    base = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) { close(fd); return -1; }
+    if (mmap(base, (size_t)st.st_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, size);
+        close(fd);
+        return -1;
+    }
+    close(fd);//the mapping keeps the file open
+    madvise(base, (size_t)st.st_size, MADV_SEQUENTIAL);
+    madvise(base, (size_t)st.st_size, MADV_WILLNEED);
+    f->base = base;
+    f->size = size;
+    f->data = (const char *)base;
+    f->len = (size_t)st.st_size;
+    f->padding = NFJSON_PADDING;
+    return 0;
+}
+
+void nfjson_file_unmap(nfjson_file *f) {
+    if (f->base) munmap(f->base, f->size);
+    memset(f, 0, sizeof(nfjson_file));
+}
+#endif
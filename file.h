@@ -0,0 +1,20 @@
+#pragma once
+#include"pch.h"
+
+/**
+*   a whole file mapped read-only. at least padding readable bytes follow
+*   data + len, so the json goes to the block kernels without a heap copy
+**/
+typedef struct {
+    const char *data;
+    size_t len;
+    size_t padding;
+    void *base;/*start of the mapping*/
+    size_t size;/*bytes mapped*/
+    void *handle;/*file mapping object, Windows only*/
+}nfjson_file;
+
+/* 0 on success */
+int nfjson_file_map(nfjson_file *f, const char *path);
+
+void nfjson_file_unmap(nfjson_file *f);
@@ -1,149 +1,425 @@
 #include"pch.h"
 #include"hash_table.h"
+#include"simd.h"
+#if defined(_WIN32)
+#include<windows.h>
+#include<bcrypt.h>
+#pragma comment(lib, "bcrypt.lib")
+#else
+#include<fcntl.h>
+#include<unistd.h>
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 25)
+#include<sys/random.h>
+#define HT_GETRANDOM
+#endif
+#endif
 
-static unsigned int hashcode(char *key) {
-    unsigned int hash = 0;
-    while (*key) {
-        hash = hash * 33 + *key;
-        key++;
+#define HT_GROUP 16/* control bytes compared at once */
+#define HT_EMPTY 0x80
+#define HT_DELETED 0xFE
+#define HT_H2(hash) ((unsigned char)((hash) >> 25))/* 7 bits of a full slot, the low bits pick the group */
+#define HT_GROWTH(size) ((size) - (size) / 8)/* keys that fit, 7/8 load */
+
+static const uint64_t ht_secret[4] = { 0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL, 0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL };
+
+static volatile uint64_t ht_seed;/* 0 until the first hash, then fixed for the process */
+
+/* full 128-bit product of *a and *b, low half to *a, high half to *b */
+static __inline void ht_mum(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *a = _umul128(*a, *b, b);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b, hi, lo;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32), c = t < rl;
+    lo = t + (rm1 << 32);
+    c += lo < t;
+    hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    *a = lo;
+    *b = hi;
+#endif
+}
+
+static __inline uint64_t ht_mix(uint64_t a, uint64_t b) {
+    ht_mum(&a, &b);
+    return a ^ b;
+}
+
+static __inline uint64_t ht_read8(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static __inline uint64_t ht_read4(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+/* 8 random bytes, 0 when the OS gives none */
+static uint64_t ht_os_random(void) {
+    uint64_t r = 0;
+#if defined(_WIN32)
+    if (!BCRYPT_SUCCESS(BCryptGenRandom(NULL, (PUCHAR)&r, sizeof(r), BCRYPT_USE_SYSTEM_PREFERRED_RNG))) r = 0;
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+    arc4random_buf(&r, sizeof(r));
+#else
+    int fd;
+#if defined(HT_GETRANDOM)
+    if (getrandom(&r, sizeof(r), GRND_NONBLOCK) == (ssize_t)sizeof(r)) return r;
+#endif
+    if ((fd = open("/dev/urandom", O_RDONLY)) >= 0) {
+        if (read(fd, &r, sizeof(r)) != (ssize_t)sizeof(r)) r = 0;
+        close(fd);
     }
-    return hash;
+#endif
+    return r;
+}
+
+/**
+*   seeded once from the OS, so colliding keys cannot be made ahead. the
+*   address of the seed is mixed in for when the OS has no randomness,
+*   the first seed stored wins when threads race to the first hash
+**/
+static uint64_t ht_get_seed(void) {
+#if defined(_WIN32)
+    uint64_t seed = (uint64_t)InterlockedCompareExchange64((volatile LONG64 *)&ht_seed, 0, 0);
+#else
+    uint64_t seed = __atomic_load_n(&ht_seed, __ATOMIC_ACQUIRE), expect = 0;
+#endif
+    if (seed) return seed;
+    seed = ht_os_random() ^ (uint64_t)(uintptr_t)&ht_seed;
+    seed ^= ht_mix(seed ^ ht_secret[0], ht_secret[1]);
+    seed |= seed == 0;
+#if defined(_WIN32)
+    InterlockedCompareExchange64((volatile LONG64 *)&ht_seed, (LONG64)seed, 0);
+    return (uint64_t)InterlockedCompareExchange64((volatile LONG64 *)&ht_seed, 0, 0);
+#else
+    if (!__atomic_compare_exchange_n(&ht_seed, &expect, seed, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) seed = expect;
+    return seed;
+#endif
+}
+
+/* wyhash: 16 bytes per multiply, keys up to 16 bytes in two overlapping reads */
+unsigned int hash_table_hash(const void *s, size_t len) {
+    const unsigned char *p = (const unsigned char *)s;
+    uint64_t seed = ht_get_seed(), a, b;
+    size_t i = len;
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (ht_read4(p) << 32) | ht_read4(p + ((len >> 3) << 2));
+            b = (ht_read4(p + len - 4) << 32) | ht_read4(p + len - 4 - ((len >> 3) << 2));
+        }
+        else if (len > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        }
+        else a = b = 0;
+    }
+    else {
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = ht_mix(ht_read8(p) ^ ht_secret[1], ht_read8(p + 8) ^ seed);
+                see1 = ht_mix(ht_read8(p + 16) ^ ht_secret[2], ht_read8(p + 24) ^ see1);
+                see2 = ht_mix(ht_read8(p + 32) ^ ht_secret[3], ht_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = ht_mix(ht_read8(p) ^ ht_secret[1], ht_read8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = ht_read8(p + i - 16);
+        b = ht_read8(p + i - 8);
+    }
+    a ^= ht_secret[1];
+    b ^= seed;
+    ht_mum(&a, &b);
+    a = ht_mix(a ^ ht_secret[0] ^ len, b ^ ht_secret[1]);
+    return (unsigned int)(a ^ (a >> 32));
+}
+
+static unsigned int hashcode(char *key) {
+    return hash_table_hash(key, strlen(key));
 }
 
 static int strcmp_default(const void *k, const void *key) {
     return !strcmp(k, key);
 }
 
+static void *ht_alloc(hash_table *ht, size_t size) {
+    return ht->alloc ? ht->alloc(ht->alloc_ctx, size) : malloc(size);
+}
+
+/* bit i for control byte i of the group equal to b */
+static __inline unsigned int ht_match(const unsigned char *ctrl, unsigned char b) {
+#if defined(NFJSON_SSE2)
+    return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)ctrl), _mm_set1_epi8((char)b)));
+#else
+    unsigned int m = 0;
+    int i;
+    for (i = 0; i < HT_GROUP; i++) m |= (unsigned int)(ctrl[i] == b) << i;
+    return m;
+#endif
+}
+
+/* empty or deleted, the bytes with the high bit set */
+static __inline unsigned int ht_match_free(const unsigned char *ctrl) {
+#if defined(NFJSON_SSE2)
+    return (unsigned int)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+    unsigned int m = 0;
+    int i;
+    for (i = 0; i < HT_GROUP; i++) m |= (unsigned int)(ctrl[i] >> 7) << i;
+    return m;
+#endif
+}
+
+/* the group at any slot is one unaligned load, the first bytes are repeated after the last */
+static void ht_set_ctrl(unsigned char *ctrl, int size, int i, unsigned char b) {
+    ctrl[i] = b;
+    if (i < HT_GROUP) ctrl[size + i] = b;
+}
+
+static void ht_alloc_table(hash_table *ht, int size) {
+    char *block = (char *)ht_alloc(ht, sizeof(kv) * size + size + HT_GROUP);
+    ht->table = (kv *)block;
+    ht->ctrl = (unsigned char *)(block + sizeof(kv) * size);
+    memset(ht->ctrl, HT_EMPTY, size + HT_GROUP);
+    ht->table_size = size;
+    ht->growth_left = HT_GROWTH(size);
+}
+
+static int ht_size_for(int count) {//smallest table count keys fit in
+    int size = HT_GROUP;
+    while (HT_GROWTH(size) < count && size <= 1 << 29) size <<= 1;
+    return size;
+}
+
 hash_table *new_hash_table(int init_capacity, unsigned int(*hash_func)(void *key),
     int(*cmp_func)(const void *k, const void *key), void(*free_key)(void *ptr), void(*free_value)(void *ptr)){
-    float f = (float)(init_capacity - 1);
-    init_capacity = 1 << ((*(unsigned int*)(&f) >> 23) - 126);
-    if (init_capacity < 8) init_capacity = 8;
-    hash_table *ht = (hash_table *)malloc(sizeof(hash_table));
-    ht->table = (kv **)malloc(sizeof(kv *)*init_capacity);
-    memset(ht->table, 0, sizeof(kv *)*init_capacity);
+    return new_hash_table_with_alloc(init_capacity, hash_func, cmp_func, free_key, free_value, NULL, NULL);
+}
+
+//with alloc, the table never frees its memory and free_key / free_value default to nothing
+hash_table *new_hash_table_with_alloc(int init_capacity, unsigned int(*hash_func)(void *key),
+    int(*cmp_func)(const void *k, const void *key), void(*free_key)(void *ptr), void(*free_value)(void *ptr),
+    void *(*alloc)(void *ctx, size_t size), void *alloc_ctx) {
+    hash_table *ht = (hash_table *)(alloc ? alloc(alloc_ctx, sizeof(hash_table)) : malloc(sizeof(hash_table)));
+    ht->alloc = alloc;
+    ht->alloc_ctx = alloc_ctx;
+    ht_alloc_table(ht, ht_size_for(init_capacity));
+    ht->old_table = NULL;
+    ht->old_ctrl = NULL;
+    ht->old_size = ht->moved = 0;
+    ht->rehash_step = 0;
     ht->cnt = 0;
-    ht->table_size = init_capacity;
     ht->hash_func = hash_func ? hash_func : hashcode;
     ht->cmp_func = cmp_func ? cmp_func : strcmp_default;
-    ht->free_key = free_key ? free_key : free;
-    ht->free_value = free_value ? free_value : free;
+    ht->free_key = free_key ? free_key : alloc ? NULL : free;
+    ht->free_value = free_value ? free_value : alloc ? NULL : free;
     return ht;
 }
 
-void extend(hash_table *ht) {
-    ht->cnt++;
-    if (ht->cnt*1.0 / ht->table_size > 0.75 && ht->table_size << 1 <= 1073741824) {//1073741824    1<<30
-        int old_size = ht->table_size;
-        ht->table_size <<= 1;
-        ht->table = (kv **)realloc(ht->table, sizeof(kv *)*ht->table_size);
-        memset(ht->table + old_size, 0, sizeof(kv *)*old_size);
-        kv **table = ht->table;
-        
-        //move all kv to new table
-        int i = 0;
-        for (; i < old_size; i++) {
-            if (table[i]) {
-                kv *kv_list = table[i];
-                kv *lowHead = NULL, *lowTail = NULL, *highHead = NULL, *highTail = NULL;
-                do {//move the list
-                    if (kv_list->hash & old_size) {//move
-                        if (highHead == NULL) { highHead = kv_list; }
-                        else { highTail->next = kv_list; }
-                        highTail = kv_list;
-                    }
-                    else {//not move
-                        if (lowHead == NULL) { lowHead = kv_list; }
-                        else { lowTail->next = kv_list; }
-                        lowTail = kv_list;
-                    }
-                } while (kv_list = kv_list->next);
-                if(lowTail) lowTail->next = NULL;
-                if (highTail) { 
-                    highTail->next = NULL;
-                    ht->table[i] = lowHead;
-                    ht->table[i + old_size] = highHead; 
-                }
-            }
+/**
+*   groups are probed at triangular steps from hash & mask, which visits
+*   every group of a power of 2 table. an empty byte in a group ends the
+*   search, a put never fills the last empty slot
+**/
+static int ht_find(hash_table *ht, const kv *table, const unsigned char *ctrl, int size, void *key, unsigned int hash) {//slot of key, -1 if absent
+    int mask = size - 1, pos = hash & mask, step = 0, i;
+    unsigned char h2 = HT_H2(hash);
+    unsigned int m;
+    for (;;) {
+        const unsigned char *g = ctrl + pos;
+        for (m = ht_match(g, h2); m; m &= m - 1) {
+            i = (pos + nfjson_ctz32(m)) & mask;
+            if (table[i].hash == hash && ht->cmp_func(key, table[i].key)) return i;
         }
+        if (ht_match(g, HT_EMPTY)) return -1;
+        step += HT_GROUP;
+        pos = (pos + step) & mask;
     }
 }
 
+static int ht_find_free(const unsigned char *ctrl, int size, unsigned int hash) {//first empty or deleted slot where hash probes
+    int mask = size - 1, pos = hash & mask, step = 0;
+    unsigned int m;
+    while (!(m = ht_match_free(ctrl + pos))) {
+        step += HT_GROUP;
+        pos = (pos + step) & mask;
+    }
+    return (pos + nfjson_ctz32(m)) & mask;
+}
+
+/**
+*   while growing, keys not moved yet stay in the old table and are found
+*   there. every operation moves rehash_step old slots, a moved slot is
+*   left deleted so that the probes through it go on
+**/
+static void ht_move(hash_table *ht, int slots) {
+    int end = ht->old_size - ht->moved < slots ? ht->old_size : ht->moved + slots, i, j;
+    for (i = ht->moved; i < end; i++) {
+        if (ht->old_ctrl[i] & 0x80) continue;
+        j = ht_find_free(ht->ctrl, ht->table_size, ht->old_table[i].hash);
+        ht_set_ctrl(ht->ctrl, ht->table_size, j, ht->old_ctrl[i]);
+        ht->table[j] = ht->old_table[i];
+        ht_set_ctrl(ht->old_ctrl, ht->old_size, i, HT_DELETED);
+    }
+    ht->moved = end;
+    if (end < ht->old_size) return;
+    if (!ht->alloc) free(ht->old_table);
+    ht->old_table = NULL;
+    ht->old_ctrl = NULL;
+    ht->old_size = ht->moved = 0;
+}
+
+/* keys move to a table of size, deleted slots are dropped on the way */
+static void ht_resize(hash_table *ht, int size) {
+    if (ht->old_table) ht_move(ht, ht->old_size);//the previous growth ends first
+    ht->old_table = ht->table;
+    ht->old_ctrl = ht->ctrl;
+    ht->old_size = ht->table_size;
+    ht->moved = 0;
+    ht_alloc_table(ht, size);
+    ht->growth_left -= ht->cnt;//taken now by the keys on their way
+    if (ht->rehash_step == 0) ht_move(ht, ht->old_size);
+}
+
+void hash_table_set_rehash_step(hash_table *ht, int step) {
+    assert(step >= 0);
+    if (step == 0 && ht->old_table) ht_move(ht, ht->old_size);
+    ht->rehash_step = step;
+}
+
 void *hash_table_put(hash_table *ht, void *key, void *val) {//return oldval when update else return NULL
-    int hash = ht->hash_func(key);
-    int h = hash & (ht->table_size - 1);
-    kv *kv_list = ht->table[h];
-    while (kv_list) {
-        if (hash == kv_list->hash && ht->cmp_func(key, kv_list->key)) {
-            void *old = kv_list->val;
-            kv_list->val = val;
+    unsigned int hash = ht->hash_func(key);
+    int i;
+    void *old;
+    if (ht->old_table) {
+        ht_move(ht, ht->rehash_step);
+        if (ht->old_table && (i = ht_find(ht, ht->old_table, ht->old_ctrl, ht->old_size, key, hash)) >= 0) {
+            old = ht->old_table[i].val;
+            ht->old_table[i].val = val;
             return old;
         }
-        else kv_list = kv_list->next;
     }
-    kv *new_kv = (kv *)malloc(sizeof(kv));
-    new_kv->next = ht->table[h];
-    new_kv->key = key;
-    new_kv->val = val;
-    new_kv->hash = hash;
-    ht->table[h] = new_kv;
-    extend(ht);
+    if ((i = ht_find(ht, ht->table, ht->ctrl, ht->table_size, key, hash)) >= 0) {
+        old = ht->table[i].val;
+        ht->table[i].val = val;
+        return old;
+    }
+    i = ht_find_free(ht->ctrl, ht->table_size, hash);
+    if (ht->growth_left == 0 && ht->ctrl[i] == HT_EMPTY) {//mostly deleted slots are cleaned at the same size
+        ht_resize(ht, ht->cnt >= HT_GROWTH(ht->table_size) / 2 && ht->table_size <= 1 << 29 ? ht->table_size << 1 : ht->table_size);
+        i = ht_find_free(ht->ctrl, ht->table_size, hash);
+    }
+    if (ht->ctrl[i] == HT_EMPTY) ht->growth_left--;
+    ht_set_ctrl(ht->ctrl, ht->table_size, i, HT_H2(hash));
+    ht->table[i].key = key;
+    ht->table[i].val = val;
+    ht->table[i].hash = hash;
+    ht->cnt++;
     return NULL;
 }
 
+hash_table *new_hash_table_bulk(int count, void *keys, size_t key_stride, void *vals, size_t val_stride,
+    unsigned int(*hash_func)(void *key),
+    int(*cmp_func)(const void *k, const void *key), void(*free_key)(void *ptr), void(*free_value)(void *ptr),
+    void *(*alloc)(void *ctx, size_t size), void *alloc_ctx) {
+    hash_table *ht = new_hash_table_with_alloc(count, hash_func, cmp_func, free_key, free_value, alloc, alloc_ctx);
+    unsigned int hash;
+    void *key, *val;
+    int i, j;
+    for (i = 0; i < count; i++) {//never grows, no growth check
+        key = (char *)keys + key_stride * i;
+        val = (char *)vals + val_stride * i;
+        hash = ht->hash_func(key);
+        if ((j = ht_find(ht, ht->table, ht->ctrl, ht->table_size, key, hash)) >= 0) {
+            if (ht->free_key) ht->free_key(key);
+            if (ht->free_value) ht->free_value(ht->table[j].val);
+            ht->table[j].val = val;
+            continue;
+        }
+        j = ht_find_free(ht->ctrl, ht->table_size, hash);
+        ht_set_ctrl(ht->ctrl, ht->table_size, j, HT_H2(hash));
+        ht->table[j].key = key;
+        ht->table[j].val = val;
+        ht->table[j].hash = hash;
+        ht->growth_left--;
+        ht->cnt++;
+    }
+    return ht;
+}
+
 void *hash_table_get(hash_table *ht, void *key) {
-    int hash = ht->hash_func(key);
-    int h = hash & (ht->table_size - 1);
-    kv *kv_list = ht->table[h];
-    while (kv_list) {
-        if (hash == kv_list->hash && ht->cmp_func(key, kv_list->key))return kv_list->val;
-        else kv_list = kv_list->next;
+    return hash_table_get_with_hash(ht, key, ht->hash_func(key));
+}
+
+void *hash_table_get_with_hash(hash_table *ht, void *key, unsigned int hash) {
+    int i;
+    if (ht->old_table) {
+        ht_move(ht, ht->rehash_step);
+        if (ht->old_table && (i = ht_find(ht, ht->old_table, ht->old_ctrl, ht->old_size, key, hash)) >= 0) return ht->old_table[i].val;
     }
-    return NULL;
+    i = ht_find(ht, ht->table, ht->ctrl, ht->table_size, key, hash);
+    return i >= 0 ? ht->table[i].val : NULL;
 }
 
 void *hash_table_remove(hash_table *ht, void *key) {// free key in kv
-    int hash = ht->hash_func(key);
-    int h = hash & (ht->table_size - 1);
-    kv *kv_list = ht->table[h];
-    if (kv_list) {
-        kv *obj = NULL;
-        if (hash == kv_list->hash && ht->cmp_func(key, kv_list->key)) { obj = kv_list; ht->table[h] = kv_list->next; }
-        else while (kv_list->next) {
-            if (hash == kv_list->next->hash && ht->cmp_func(key, kv_list->next->key)) {
-                obj = kv_list->next;
-                kv_list->next = obj->next;
-                break;
-            }
-            kv_list = kv_list->next;
-        }
-        if (obj) {
-            ht->free_key(obj->key);
-            void *val = obj->val;
-            free(obj);
-            ht->cnt--;
-            return val;
+    unsigned int hash = ht->hash_func(key), before, after;
+    kv *table = ht->table;
+    unsigned char *ctrl = ht->ctrl;
+    int size = ht->table_size, i = -1;
+    void *val;
+    if (ht->old_table) {
+        ht_move(ht, ht->rehash_step);
+        if (ht->old_table && (i = ht_find(ht, ht->old_table, ht->old_ctrl, ht->old_size, key, hash)) >= 0) {
+            table = ht->old_table;//left deleted, the old table takes no more keys
+            ctrl = ht->old_ctrl;
+            size = ht->old_size;
+            ht->growth_left++;//the room kept for it in the new table
         }
     }
-    return NULL;
+    if (i < 0 && (i = ht_find(ht, table, ctrl, size, key, hash)) < 0) return NULL;
+    before = ht_match(ctrl + ((i - HT_GROUP) & (size - 1)), HT_EMPTY);
+    after = ht_match(ctrl + i, HT_EMPTY);
+    //every group holding i has an empty slot as well, no probe ever went past i
+    if (ctrl == ht->ctrl && before && after && nfjson_clz64(before) - (64 - HT_GROUP) + nfjson_ctz32(after) < HT_GROUP) {
+        ht_set_ctrl(ctrl, size, i, HT_EMPTY);
+        ht->growth_left++;
+    }
+    else ht_set_ctrl(ctrl, size, i, HT_DELETED);
+    if (ht->free_key) ht->free_key(table[i].key);
+    val = table[i].val;
+    ht->cnt--;
+    return val;
+}
+
+static void ht_free_entries(hash_table *ht, const kv *table, const unsigned char *ctrl, int size) {
+    int i;
+    for (i = 0; i < size; i++) {
+        if (ctrl[i] & 0x80) continue;
+        if (ht->free_key) ht->free_key(table[i].key);
+        if (ht->free_value) ht->free_value(table[i].val);
+    }
 }
 
 void hash_table_free(hash_table *ht) {//free key and value
-    int cnt = ht->cnt, i = 0;
-    kv *del = NULL;
-    void (*ht_free_key)() = ht->free_key;
-    void (*ht_free_val)() = ht->free_value;
-    while (cnt) {
-        while (ht->table[i]) {
-            del = ht->table[i];
-            ht->table[i] = del->next;
-            ht_free_key(del->key);
-            ht->free_value(del->val);
-            free(del);
-            cnt--;
-        }
-        i++;
+    if (ht->free_key || ht->free_value) {
+        ht_free_entries(ht, ht->table, ht->ctrl, ht->table_size);
+        if (ht->old_table) ht_free_entries(ht, ht->old_table, ht->old_ctrl, ht->old_size);
     }
+    if (ht->alloc) return;
+    free(ht->old_table);
     free(ht->table);
     free(ht);
-}
\ No newline at end of file
+}
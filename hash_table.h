@@ -1,30 +1,75 @@
 #pragma once
 #include"pch.h"
 
+/**
+*   open addressing with one control byte per slot: empty, deleted, or the
+*   top 7 bits of the hash of a full slot. a lookup compares 16 control
+*   bytes at once and only touches the slots whose bits match
+**/
 typedef struct _kv {
     void *key;
     void *val;
     unsigned int hash;
-    struct _kv *next;
 }kv;
 
 typedef struct {
-    kv* *table;
+    kv *table;/*table_size slots*/
+    unsigned char *ctrl;/*table_size control bytes, the first 16 repeated after them*/
     unsigned int(*hash_func)(void *key);
     int (*cmp_func)(const void *k, const void *key);
     void (*free_key)(void *ptr);
     void (*free_value)(void *ptr);
+    void *(*alloc)(void *ctx, size_t size);/*NULL for malloc, otherwise the owner of ctx releases all memory*/
+    void *alloc_ctx;
     int cnt;
-    int table_size;
+    int table_size;/*a power of 2, 16 at least*/
+    int growth_left;/*puts into empty slots before the table grows*/
+    kv *old_table;/*while growing, the slots not moved yet. NULL otherwise*/
+    unsigned char *old_ctrl;
+    int old_size;
+    int moved;/*old slots before moved are all in table*/
+    int rehash_step;/*old slots moved per operation while growing, 0 moves them all at once*/
 }hash_table;
 
-hash_table *new_hash_table(int init_capacity, unsigned int(*hash_func)(void *key), 
+/**
+*   hash of [s, s + len), the default for '\0' terminated keys. a word at a
+*   time and seeded once per process from the OS, colliding keys cannot be made ahead
+**/
+unsigned int hash_table_hash(const void *s, size_t len);
+
+/* init_capacity keys fit without growing */
+hash_table *new_hash_table(int init_capacity, unsigned int(*hash_func)(void *key),
     int (*cmp_func)(const void *k, const void *key), void (*free_key)(void *ptr), void (*free_value)(void *ptr));
 
+hash_table *new_hash_table_with_alloc(int init_capacity, unsigned int(*hash_func)(void *key),
+    int (*cmp_func)(const void *k, const void *key), void (*free_key)(void *ptr), void (*free_value)(void *ptr),
+    void *(*alloc)(void *ctx, size_t size), void *alloc_ctx);
+
+/**
+*   presized for count keys and filled in one pass. key i is at keys +
+*   i * key_stride and value i at vals + i * val_stride: fixed-size keys
+*   side by side, or fields of an array of structs. a repeated key keeps
+*   the first key and the last value
+**/
+hash_table *new_hash_table_bulk(int count, void *keys, size_t key_stride, void *vals, size_t val_stride,
+    unsigned int(*hash_func)(void *key),
+    int (*cmp_func)(const void *k, const void *key), void (*free_key)(void *ptr), void (*free_value)(void *ptr),
+    void *(*alloc)(void *ctx, size_t size), void *alloc_ctx);
+
+/**
+*   a step > 0 spreads growing over the operations after it, none of them
+*   moves more than step slots unless the table grows again before that is
+*   done, then the rest moves first. 0, the default, grows in one go
+**/
+void hash_table_set_rehash_step(hash_table *ht, int step);
+
 void * hash_table_put(hash_table * ht, void * key, void * val);
 
 void * hash_table_get(hash_table * ht, void * key);
 
+/* hash is what hash_func gives for key, computed by the caller once */
+void *hash_table_get_with_hash(hash_table *ht, void *key, unsigned int hash);
+
 void * hash_table_remove(hash_table * ht, void * key);//free key in kv
 
 void hash_table_free(hash_table * ht);//free key and value
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include"pch.h"
 #include"notfastjson.h"
 #include "memory.h"
+#include"object.h"
 
 void nfjson_init(nfjson_value *val) {
     memset(val, 0, sizeof(nfjson_value));
@@ -23,7 +24,7 @@ void nfjson_free(nfjson_value *val) {
         if (val->u.a.e) { free(val->u.a.e); }
     }; break;
     case JSON_OBJECT:
-        if (val->u.ht) { hash_table_free(val->u.ht); }break;
+        if (val->u.o) { nfjson_object_free(val->u.o); }break;
     default:
         break;
     }
@@ -35,4 +36,89 @@ void nfjson_string_free(nfjson_string *str) {
     assert(str);
     if (str->s) { free(str->s); str->s = NULL; }
     free(str);
-}
\ No newline at end of file
+}
+
+#ifndef NFJSON_ARENA_CHUNK_SIZE
+#define NFJSON_ARENA_CHUNK_SIZE 4096
+#endif
+#ifndef NFJSON_ARENA_CHUNK_MAX
+#define NFJSON_ARENA_CHUNK_MAX (1 << 20)
+#endif
+#define NFJSON_ARENA_ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+void nfjson_arena_init(nfjson_arena *arena) {
+    assert(arena);
+    arena->chunk = NULL;
+    arena->next_size = NFJSON_ARENA_CHUNK_SIZE;
+    arena->spare = NULL;
+}
+
+/* bump allocation, chunk sizes double up to NFJSON_ARENA_CHUNK_MAX */
+void *nfjson_arena_alloc(nfjson_arena *arena, size_t size) {
+    assert(arena);
+    nfjson_arena_chunk *chunk = arena->chunk;
+    size = NFJSON_ARENA_ALIGN(size);
+    if (!chunk || chunk->size - chunk->top < size) {
+        if ((chunk = arena->spare) && chunk->size >= size) arena->spare = chunk->prev;
+        else {
+            size_t chunk_size = arena->next_size;
+            if (chunk_size < size) chunk_size = size;//oversized, gets a chunk of its own
+            chunk = (nfjson_arena_chunk *)malloc(sizeof(nfjson_arena_chunk) + chunk_size);
+            chunk->size = chunk_size;
+            if (arena->next_size < NFJSON_ARENA_CHUNK_MAX) arena->next_size <<= 1;
+        }
+        chunk->prev = arena->chunk;
+        chunk->top = 0;
+        arena->chunk = chunk;
+    }
+    void *re = (char *)(chunk + 1) + chunk->top;
+    chunk->top += size;
+    return re;
+}
+
+nfjson_arena_mark nfjson_arena_get_mark(const nfjson_arena *arena) {
+    nfjson_arena_mark mark;
+    mark.chunk = arena->chunk;
+    mark.top = arena->chunk ? arena->chunk->top : 0;
+    return mark;
+}
+
+/* release everything allocated after mark, whole chunks are kept as spare */
+void nfjson_arena_rollback(nfjson_arena *arena, nfjson_arena_mark mark) {
+    assert(arena);
+    while (arena->chunk != mark.chunk) {
+        nfjson_arena_chunk *prev = arena->chunk->prev;
+        arena->chunk->prev = arena->spare;
+        arena->spare = arena->chunk;
+        arena->chunk = prev;
+    }
+    if (arena->chunk) arena->chunk->top = mark.top;
+}
+
+/* empty the arena but keep its chunks for the next allocations, oldest first */
+void nfjson_arena_reset(nfjson_arena *arena) {
+    assert(arena);
+    while (arena->chunk) {
+        nfjson_arena_chunk *prev = arena->chunk->prev;
+        arena->chunk->prev = arena->spare;
+        arena->spare = arena->chunk;
+        arena->chunk = prev;
+    }
+}
+
+void nfjson_arena_free(nfjson_arena *arena) {
+    nfjson_arena_reset(arena);
+    while (arena->spare) {
+        nfjson_arena_chunk *prev = arena->spare->prev;
+        free(arena->spare);
+        arena->spare = prev;
+    }
+    nfjson_arena_init(arena);
+}
+
+/* nodes of the document live in its arena, never pass them to nfjson_free */
+void nfjson_document_free(nfjson_document *doc) {
+    assert(doc);
+    nfjson_arena_free(&doc->arena);
+    nfjson_init(&doc->root);
+}
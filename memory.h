@@ -6,3 +6,17 @@ void nfjson_init(nfjson_value * val);
 void nfjson_free(nfjson_value * val);
 
 void nfjson_string_free(nfjson_string * str);
+
+void nfjson_arena_init(nfjson_arena * arena);
+
+void * nfjson_arena_alloc(nfjson_arena * arena, size_t size);
+
+nfjson_arena_mark nfjson_arena_get_mark(const nfjson_arena * arena);
+
+void nfjson_arena_rollback(nfjson_arena * arena, nfjson_arena_mark mark);
+
+void nfjson_arena_reset(nfjson_arena * arena);
+
+void nfjson_arena_free(nfjson_arena * arena);
+
+void nfjson_document_free(nfjson_document * doc);
@@ -0,0 +1,87 @@
+#include"pch.h"
+#include"notfastjson.h"
+#include"ndjson.h"
+#include"parse.h"
+#include"memory.h"
+
+#ifndef NFJSON_NDJSON_BATCH
+#define NFJSON_NDJSON_BATCH 4096/*records parsed between two deliveries*/
+#endif
+#ifndef NFJSON_NDJSON_CLAIM
+#define NFJSON_NDJSON_CLAIM 16/*records a worker takes at once*/
+#endif
+
+typedef struct {
+    const char *json;
+    size_t len;
+    size_t line;
+    int status;
+    nfjson_value val;
+}nfjson_ndjson_record;
+
+typedef struct {
+    nfjson_ndjson_record *records;
+    size_t count;
+    volatile size_t next;/*first record not claimed by a worker*/
+    const nfjson_parse_options *opts;
+}nfjson_ndjson_batch;
+
+/**
+*   every worker parses records until none is left, each parse keeps its
+*   context on the worker stack. the value a slot held in the last batch is
+*   freed here too, off the thread that delivers
+**/
+static void nfjson_ndjson_work(void *arg, unsigned worker) {
+    nfjson_ndjson_batch *b = (nfjson_ndjson_batch *)arg;
+    nfjson_ndjson_record *r;
+    size_t i, end;
+    (void)worker;
+    while ((i = nfjson_atomic_fetch_add(&b->next, NFJSON_NDJSON_CLAIM)) < b->count) {
+        end = b->count - i > NFJSON_NDJSON_CLAIM ? i + NFJSON_NDJSON_CLAIM : b->count;
+        for (; i < end; i++) {
+            r = b->records + i;
+            nfjson_free(&r->val);
+            r->status = nfjson_parse_opts(&r->val, r->json, r->len, b->opts);
+        }
+    }
+}
+
+static int nfjson_ndjson_blank(const char *s, const char *end) {
+    while (s < end && (*s == ' ' || *s == '\t' || *s == '\r')) s++;
+    return s == end;
+}
+
+int nfjson_parse_ndjson(nfjson_pool *pool, const char *json, size_t len, nfjson_ndjson_fn fn, void *ctx,
+                                                            const nfjson_parse_options *opts) {
+    nfjson_ndjson_batch b;
+    nfjson_ndjson_record *r;
+    const char *p = json, *end = json + len, *eol;
+    size_t line = 0, i;
+    int parse_status = NFJSON_PARSE_OK;
+    assert(NULL != fn && (NULL != json || len == 0));
+    b.records = (nfjson_ndjson_record *)malloc(sizeof(nfjson_ndjson_record) * NFJSON_NDJSON_BATCH);
+    for (i = 0; i < NFJSON_NDJSON_BATCH; i++) nfjson_init(&b.records[i].val);
+    b.opts = opts;
+    while (p < end && parse_status == NFJSON_PARSE_OK) {
+        for (b.count = 0, b.next = 0; p < end && b.count < NFJSON_NDJSON_BATCH; p = eol < end ? eol + 1 : end) {
+            if ((eol = (const char *)memchr(p, '\n', end - p)) == NULL) eol = end;//the last line may go without '\n'
+            line++;
+            if (nfjson_ndjson_blank(p, eol)) continue;
+            r = b.records + b.count++;
+            r->json = p;
+            r->len = eol - p;
+            r->line = line;
+        }
+        nfjson_pool_run(pool, nfjson_ndjson_work, &b);
+        for (i = 0; i < b.count; i++) {
+            r = b.records + i;
+            if (!fn(ctx, r->line, r->status, &r->val)) {
+                parse_status = NFJSON_PARSE_STOPPED;
+                break;
+            }
+        }
+    }
+    for (i = 0; i < NFJSON_NDJSON_BATCH; i++) nfjson_free(&b.records[i].val);
+    free(b.records);
+    return parse_status;
+}
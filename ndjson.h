@@ -0,0 +1,19 @@
+#pragma once
+#include"pch.h"
+#include"notfastjson.h"
+#include"thread.h"
+
+/**
+*   newline-delimited json (JSON Lines): every line is one record, blank
+*   lines are skipped. a raw '\n' never occurs inside a valid record, so
+*   boundaries are found with memchr alone. records are parsed in batches on
+*   the workers of pool, NULL parses on the caller, and handed to fn in
+*   input order with their 1-based line number and parse status. a failed
+*   record does not stop the others.
+*   val is freed after fn returns, fn keeps it by copying *val and calling
+*   nfjson_init(val). fn returning 0 ends the batch with NFJSON_PARSE_STOPPED.
+**/
+typedef int (*nfjson_ndjson_fn)(void *ctx, size_t line, int status, nfjson_value *val);
+
+int nfjson_parse_ndjson(nfjson_pool *pool, const char *json, size_t len, nfjson_ndjson_fn fn, void *ctx,
+                                                            const nfjson_parse_options *opts);
@@ -4,7 +4,8 @@
 
 typedef enum {
     JSON_NULL, JSON_FALSE, JSON_TRUE, JSON_NUMBER, JSON_STRING, 
-    JSON_ARRAY, JSON_OBJECT, JSON_UNRESOLVED
+    JSON_ARRAY, JSON_OBJECT, JSON_UNRESOLVED,
+    JSON_LAZY/*not decoded yet, see nfjson_parse_document_lazy, never returned by the accessors*/
 }nfjson_type;
 
 enum {
@@ -26,25 +27,177 @@ enum {
     NFJSON_STRINGIFY_OK,
     NFJSON_STRINGIFY_UNRESOLVED_TYPE,
     NFJSON_STRINGIFY_INVALID_TYPE,
+    NFJSON_PARSE_TOO_DEEP,/*nesting beyond nfjson_parse_options.max_depth*/
+    NFJSON_PARSE_STOPPED,/*a nfjson_sax_handler callback returned 0*/
+    NFJSON_PARSE_IO_ERROR,/*nfjson_parse_file could not open or map the file*/
+    NFJSON_PARSE_INVALID_UTF8,/*a string is not well-formed UTF-8*/
 };
 
+/* representation of a JSON_NUMBER: integer literals that fit 64 bits are kept exact */
+typedef enum {
+    NFJSON_NUMBER_DOUBLE, NFJSON_NUMBER_INT64, NFJSON_NUMBER_UINT64
+}nfjson_number_type;
+
 typedef struct nfjson_value nfjson_value;
 
 typedef struct { char *s; size_t len; } nfjson_string;
 
+typedef struct nfjson_lazy nfjson_lazy;
+
+typedef struct nfjson_projection nfjson_projection;
+
+typedef struct nfjson_object nfjson_object;
+
 struct nfjson_value {
     union {
         nfjson_string s;/* type == JSON_STRING */
         struct { nfjson_value *e; size_t len; }a;/* type == JSON_ARRAY */
-        hash_table *ht;/* type == JSON_OBJECT */
-        double n;/* type == JSON_NUMBER */
+        nfjson_object *o;/* type == JSON_OBJECT, NULL when empty */
+        double n;/* type == JSON_NUMBER, ntype == NFJSON_NUMBER_DOUBLE */
+        int64_t i;/* ntype == NFJSON_NUMBER_INT64 */
+        uint64_t ui;/* ntype == NFJSON_NUMBER_UINT64 */
+        struct { const char *json; const nfjson_lazy *doc; }lazy;/* type == JSON_LAZY */
     }u;
     nfjson_type type;
+    nfjson_number_type ntype;/* type == JSON_NUMBER, fits the padding after type */
 };/* may using C11 grammar like v->s for  v->u.s.s */
 
+typedef struct nfjson_arena_chunk nfjson_arena_chunk;
+
+struct nfjson_arena_chunk {
+    nfjson_arena_chunk *prev;/*older chunk*/
+    size_t size;/*usable bytes after the header*/
+    size_t top;/*bump pointer*/
+};
+
+typedef struct {
+    nfjson_arena_chunk *chunk;/*current chunk*/
+    size_t next_size;/*size of the next chunk*/
+    nfjson_arena_chunk *spare;/*emptied by nfjson_arena_reset, used again before malloc*/
+}nfjson_arena;
+
+typedef struct {
+    nfjson_arena_chunk *chunk;
+    size_t top;
+}nfjson_arena_mark;
+
+typedef struct {
+    nfjson_string key;
+    nfjson_value val;
+}nfjson_member;
+
+/* members in input order, see object.h */
+struct nfjson_object {
+    size_t len;
+    nfjson_member *m;/*right after the object*/
+    hash_table *index;/*key to member, NULL while lookups scan m*/
+    size_t lookups;/*scans so far, malloc objects only*/
+    nfjson_arena *arena;/*owner of the object and its index, NULL for malloc*/
+};
+
+/**
+*   a key looked up on many objects: hashed once, and the position it last
+*   matched is tried first, which hits right away on objects of one shape
+**/
+typedef struct {
+    nfjson_string name;/*borrowed*/
+    unsigned int hash;
+    size_t pos;/*member it last matched, only a hint*/
+}nfjson_key;
+
+/* a parsed json owning all of its nodes, keys, strings and object indexes in one arena */
+typedef struct {
+    nfjson_value root;
+    nfjson_arena arena;
+}nfjson_document;
+
+/* where parsed strings live */
+enum {
+    NFJSON_STRING_COPY = 0,/*copied out of the json*/
+    NFJSON_STRING_BORROW,/*escape-free strings point into the json*/
+    NFJSON_STRING_INSITU,/*unescaped inside the writable json*/
+};
+
+/* runtime parse settings, zero fields keep the defaults */
+typedef struct {
+    size_t max_depth;/*arrays and objects open at once, NFJSON_PARSE_MAX_DEPTH if 0*/
+    int skip_utf8;/*trusted input, strings are not checked for well-formed UTF-8*/
+}nfjson_parse_options;
+
+/**
+*   events of a parse in document order, see nfjson_parse_sax. every callback
+*   returns nonzero to go on, NULL callbacks are skipped. strings and keys are
+*   not terminated and only valid during the call
+**/
+typedef struct {
+    int (*null)(void *ctx);
+    int (*boolean)(void *ctx, int b);
+    int (*number)(void *ctx, const nfjson_value *num);/*read with nfjson_get_number / int64 / uint64*/
+    int (*string)(void *ctx, const char *s, size_t len);
+    int (*key)(void *ctx, const char *s, size_t len);
+    int (*start_object)(void *ctx);
+    int (*end_object)(void *ctx, size_t members);
+    int (*start_array)(void *ctx);
+    int (*end_array)(void *ctx, size_t elements);
+}nfjson_sax_handler;
+
 typedef struct {
     const char *json;/*the parsing position in the json*/
+    const char *end;/*end of the json, no '\0' needed*/
+    size_t padding;/*readable bytes after end, see NFJSON_PADDING*/
     char *stack;/*parsing buffer*/
     size_t size;/*size of stack*/
     size_t top;/*pointer of stack*/
+    nfjson_arena *arena;/*owner of parsed nodes, NULL for malloc*/
+    int strings;/*NFJSON_STRING_COPY / BORROW / INSITU, not COPY only with arena*/
+    size_t max_depth;/*nesting limit of arrays and objects*/
+    int state;/*where the parse machine stopped, see parse.c*/
+    size_t frame;/*stack offset of the innermost open container*/
+    size_t depth;/*containers open*/
+    char *fixed;/*inline initial stack, never freed*/
+    const nfjson_sax_handler *sax;/*receiver of the events*/
+    void *sax_ctx;
+    int borrowed;/*the last string points into the json*/
+    int pause;/*hand the last event to the caller, see nfjson_reader*/
+    int utf8;/*check strings for well-formed UTF-8*/
 }nfjson_context;
+
+/* builds a nfjson_value from the events, see parse.c */
+typedef struct {
+    nfjson_context *c;
+    nfjson_value *root;
+    char *stack;/*build frames and element pointers*/
+    size_t size, top;
+    size_t frame;/*offset of the innermost build frame*/
+    nfjson_arena keys;/*key text of the open objects without c->arena, each object copies its own when it closes*/
+}nfjson_dom;
+
+/* push parser taking the json in chunks, see nfjson_parser_feed */
+typedef struct {
+    nfjson_context c;
+    nfjson_dom dom;
+    nfjson_document *doc;/*owner of the nodes, NULL for malloc*/
+    char *carry;/*a token split across chunks*/
+    size_t carry_len, carry_size;
+    int carry_escape;/*carry ends inside a string escape*/
+    int status;/*first error, sticky*/
+}nfjson_parser;
+
+typedef enum {
+    NFJSON_TOKEN_END,/*nothing left, or not started*/
+    NFJSON_TOKEN_NULL, NFJSON_TOKEN_FALSE, NFJSON_TOKEN_TRUE,
+    NFJSON_TOKEN_NUMBER, NFJSON_TOKEN_STRING, NFJSON_TOKEN_KEY,
+    NFJSON_TOKEN_START_OBJECT, NFJSON_TOKEN_END_OBJECT,
+    NFJSON_TOKEN_START_ARRAY, NFJSON_TOKEN_END_ARRAY
+}nfjson_token_type;
+
+/* pull parser handing out one token per nfjson_reader_next */
+typedef struct {
+    nfjson_context c;
+    nfjson_token_type type;/*the current token*/
+    const char *s;/*NFJSON_TOKEN_STRING / KEY, not terminated*/
+    size_t len;
+    nfjson_value num;/*NFJSON_TOKEN_NUMBER*/
+    size_t depth;/*containers around the token, 0 for the root*/
+    int status;/*first error, sticky*/
+}nfjson_reader;
@@ -0,0 +1,8 @@
+#pragma once
+#include"pch.h"
+#include"notfastjson.h"
+
+/* sets val to an exact int64/uint64 for integer literals that fit, a double otherwise */
+int nfjson_number_parse(const char *p, const char *end, const char **stop, nfjson_value *val);
+
+int nfjson_decimal_to_double(uint64_t w, int64_t q, int negative, double *d);
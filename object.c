@@ -0,0 +1,153 @@
+#include"pch.h"
+#include"object.h"
+#include"memory.h"
+
+static unsigned int nfjson_string_hashcode(nfjson_string *key) {//reads [0, len) only, borrowed keys are not terminated
+    return hash_table_hash(key->s, key->len);
+}
+
+//look up key "abc\0abc" matches "abc\0", cmp thr len
+static int cmp_nfjson_string_key(const nfjson_string *k, const nfjson_string *key) {
+    return k->len == key->len && (k->len == 0 || memcmp(k->s, key->s, k->len) == 0);
+}
+
+/* the index callbacks, in the types hash_table takes */
+static unsigned int nfjson_object_hash_hook(void *key) {
+    return nfjson_string_hashcode((nfjson_string *)key);
+}
+
+static int nfjson_object_cmp_hook(const void *k, const void *key) {
+    return cmp_nfjson_string_key((const nfjson_string *)k, (const nfjson_string *)key);
+}
+
+static void *nfjson_arena_alloc_hook(void *arena, size_t size) {
+    return nfjson_arena_alloc((nfjson_arena *)arena, size);
+}
+
+static void nfjson_object_keep(void *ptr) {//the index refers to members, the object owns them
+    (void)ptr;
+}
+
+/* bit of a 64-bit filter, equal keys always share it */
+static uint64_t nfjson_object_tag(const nfjson_string *key) {
+    size_t t = key->len;
+    if (t) t += (unsigned char)key->s[0] * 3 + (unsigned char)key->s[key->len - 1] * 5;
+    return (uint64_t)1 << (t & 63);
+}
+
+static nfjson_member *nfjson_object_scan(nfjson_member *m, size_t len, const nfjson_string *key) {
+    size_t i;
+    for (i = 0; i < len; i++)
+        if (cmp_nfjson_string_key(&m[i].key, key)) return m + i;
+    return NULL;
+}
+
+/* an empty index with room for capacity members, filled as they are added */
+static hash_table *nfjson_object_index_new(nfjson_object *o, size_t capacity) {
+    if (o->arena) return new_hash_table_with_alloc((int)capacity, nfjson_object_hash_hook, nfjson_object_cmp_hook, NULL, NULL,
+                                                            nfjson_arena_alloc_hook, o->arena);
+    return new_hash_table((int)capacity, nfjson_object_hash_hook, nfjson_object_cmp_hook, nfjson_object_keep, nfjson_object_keep);
+}
+
+/* the index of the members there are, their keys are distinct so one pass fills it */
+static void nfjson_object_index(nfjson_object *o) {
+    o->index = new_hash_table_bulk((int)o->len, &o->m->key, sizeof(nfjson_member), o->m, sizeof(nfjson_member),
+                                                            nfjson_object_hash_hook, nfjson_object_cmp_hook,
+                                                            o->arena ? NULL : nfjson_object_keep, o->arena ? NULL : nfjson_object_keep,
+                                                            o->arena ? nfjson_arena_alloc_hook : NULL, o->arena);
+}
+
+/* members left JSON_UNRESOLVED go, an index is built again */
+static void nfjson_object_compact(nfjson_object *o) {
+    size_t i, len = 0;
+    for (i = 0; i < o->len; i++) {
+        if (o->m[i].val.type != JSON_UNRESOLVED) o->m[len++] = o->m[i];
+    }
+    o->len = len;
+    if (o->index) {
+        if (!o->arena) hash_table_free(o->index);
+        o->index = NULL;
+        if (len >= NFJSON_OBJECT_INDEX_MIN) nfjson_object_index(o);
+    }
+}
+
+nfjson_object *nfjson_object_new(nfjson_arena *arena, const nfjson_member *m, size_t len) {
+    nfjson_object *o;
+    nfjson_member *dup;
+    uint64_t seen = 0, tag;
+    size_t i, holes = 0, text = 0;
+    char *p = NULL;
+    if (len == 0) return NULL;
+    if (arena) o = (nfjson_object *)nfjson_arena_alloc(arena, sizeof(nfjson_object) + sizeof(nfjson_member) * len);
+    else {//key text goes after the members, a repeated key leaves its room unused
+        for (i = 0; i < len; i++) text += m[i].key.len + 1;
+        o = (nfjson_object *)malloc(sizeof(nfjson_object) + sizeof(nfjson_member) * len + text);
+        p = (char *)((nfjson_member *)(o + 1) + len);
+    }
+    o->len = 0;
+    o->m = (nfjson_member *)(o + 1);
+    o->index = NULL;
+    o->lookups = 0;
+    o->arena = arena;
+    if (len >= NFJSON_OBJECT_INDEX_MIN) o->index = nfjson_object_index_new(o, len);
+    for (i = 0; i < len; i++) {
+        o->m[o->len] = m[i];
+        if (o->index) {//one probe finds a repeated key or adds the member
+            dup = (nfjson_member *)hash_table_put(o->index, &o->m[o->len].key, o->m + o->len);
+            if (dup) hash_table_put(o->index, &dup->key, dup);
+        }
+        else {//the filter skips the scan for most new keys
+            tag = nfjson_object_tag(&m[i].key);
+            dup = seen & tag ? nfjson_object_scan(o->m, o->len, &m[i].key) : NULL;
+            seen |= tag;
+        }
+        if (dup) {//repeated key, the first name is kept
+            holes += (m[i].val.type == JSON_UNRESOLVED) - (dup->val.type == JSON_UNRESOLVED);
+            if (!arena) nfjson_free(&dup->val);
+            dup->val = m[i].val;
+            continue;
+        }
+        holes += m[i].val.type == JSON_UNRESOLVED;
+        if (p) {
+            if (m[i].key.len) memcpy(p, m[i].key.s, m[i].key.len);
+            p[m[i].key.len] = 0;
+            o->m[o->len].key.s = p;
+            p += m[i].key.len + 1;
+        }
+        o->len++;
+    }
+    if (holes) nfjson_object_compact(o);
+    return o;
+}
+
+/* a malloc object looked up often enough gets its index */
+static void nfjson_object_lookup(nfjson_object *o) {
+    if (!o->index && !o->arena && o->len > NFJSON_OBJECT_SCAN_MAX && ++o->lookups >= NFJSON_OBJECT_INDEX_LOOKUPS)
+        nfjson_object_index(o);
+}
+
+nfjson_member *nfjson_object_find(nfjson_object *o, const nfjson_string *key) {
+    if (o == NULL) return NULL;
+    nfjson_object_lookup(o);
+    if (o->index) return (nfjson_member *)hash_table_get(o->index, (void *)key);
+    return nfjson_object_scan(o->m, o->len, key);
+}
+
+nfjson_member *nfjson_object_find_key(nfjson_object *o, nfjson_key *key) {
+    nfjson_member *m;
+    if (o == NULL) return NULL;
+    if (key->pos < o->len && cmp_nfjson_string_key(&o->m[key->pos].key, &key->name)) return o->m + key->pos;
+    nfjson_object_lookup(o);
+    if (o->index) m = (nfjson_member *)hash_table_get_with_hash(o->index, &key->name, key->hash);
+    else m = nfjson_object_scan(o->m, o->len, &key->name);
+    if (m) key->pos = (size_t)(m - o->m);
+    return m;
+}
+
+void nfjson_object_free(nfjson_object *o) {
+    size_t i;
+    assert(o && !o->arena);
+    for (i = 0; i < o->len; i++) nfjson_free(&o->m[i].val);
+    if (o->index) hash_table_free(o->index);
+    free(o);
+}
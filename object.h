@@ -0,0 +1,38 @@
+#pragma once
+#include"pch.h"
+#include"notfastjson.h"
+
+/**
+*   an object is its members in input order, one block after the header.
+*   lookups scan the members until the object has a hash index: objects of
+*   NFJSON_OBJECT_INDEX_MIN members get one when they are built. a malloc
+*   object of more than NFJSON_OBJECT_SCAN_MAX members gets one after
+*   NFJSON_OBJECT_INDEX_LOOKUPS scans, arena objects are never changed by a
+*   lookup so that a document can be read from many threads
+**/
+#ifndef NFJSON_OBJECT_SCAN_MAX
+#define NFJSON_OBJECT_SCAN_MAX 8
+#endif
+#ifndef NFJSON_OBJECT_INDEX_MIN
+#define NFJSON_OBJECT_INDEX_MIN 16
+#endif
+#ifndef NFJSON_OBJECT_INDEX_LOOKUPS
+#define NFJSON_OBJECT_INDEX_LOOKUPS 16
+#endif
+
+/**
+*   takes the len members of m, a repeated key keeps the first name and the
+*   last value. members whose last value is JSON_UNRESOLVED are left out,
+*   NULL for no member. without arena the key text is copied into the
+*   object's own block and m keeps its keys, with arena the keys are taken
+**/
+nfjson_object *nfjson_object_new(nfjson_arena *arena, const nfjson_member *m, size_t len);
+
+/* NULL if key is not a member, o may be NULL */
+nfjson_member *nfjson_object_find(nfjson_object *o, const nfjson_string *key);
+
+/* as nfjson_object_find, key->pos is tried first and then set to the member found */
+nfjson_member *nfjson_object_find_key(nfjson_object *o, nfjson_key *key);
+
+/* values and the object itself with its keys, only for malloc objects */
+void nfjson_object_free(nfjson_object *o);
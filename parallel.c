@@ -0,0 +1,173 @@
+#include"pch.h"
+#include"notfastjson.h"
+#include"parallel.h"
+#include"parse.h"
+#include"memory.h"
+#include<stddef.h>
+
+#ifndef NFJSON_PARALLEL_CHUNKS
+#define NFJSON_PARALLEL_CHUNKS 8/*chunks per worker, evens out slow slices*/
+#endif
+#ifndef NFJSON_PARALLEL_CHUNK_MIN
+#define NFJSON_PARALLEL_CHUNK_MIN 65536
+#endif
+
+typedef struct {
+    const char *start, *end;/*the chunk, then the slice parsed from it*/
+    size_t quotes;/*'"' not escaped*/
+    ptrdiff_t depth[2];/*net nesting outside strings if the chunk starts outside / inside one*/
+    int in_string;/*state at start*/
+    ptrdiff_t depth_at;/*nesting at start, 1 inside the root array*/
+    const char *split;/*first ',' between two elements at or after start, NULL if none*/
+    nfjson_value *e;/*elements of the slice*/
+    size_t count;
+    int status;
+}nfjson_chunk;
+
+typedef struct {
+    nfjson_chunk *chunks;
+    size_t count;
+    volatile size_t next;/*first chunk not claimed by a worker*/
+    const char *begin, *end;/*inside of the root array*/
+    const nfjson_parse_options *opts;
+}nfjson_split;
+
+static nfjson_chunk *nfjson_chunk_claim(nfjson_split *s) {
+    size_t i = nfjson_atomic_fetch_add(&s->next, 1);
+    return i < s->count ? s->chunks + i : NULL;
+}
+
+/* a '\\' run ending right before p escapes it if its length is odd, backslashes only occur in strings */
+static int nfjson_chunk_escaped(const char *begin, const char *p) {
+    int escaped = 0;
+    while (p > begin && *--p == '\\') escaped ^= 1;
+    return escaped;
+}
+
+/* pass 1: quote parity and nesting of every chunk, for both string states it may start in */
+static void nfjson_chunk_scan(void *arg, unsigned worker) {
+    nfjson_split *s = (nfjson_split *)arg;
+    nfjson_chunk *ch;
+    const char *p;
+    (void)worker;
+    while ((ch = nfjson_chunk_claim(s)) != NULL) {
+        int escaped = nfjson_chunk_escaped(s->begin, ch->start);
+        size_t quotes = 0;
+        ptrdiff_t depth[2] = { 0, 0 };
+        for (p = ch->start; p < ch->end; p++) {
+            if (escaped) { escaped = 0; continue; }
+            switch (*p) {
+            case '\\': escaped = 1; break;
+            case '"': quotes++; break;
+            case '[': case '{': depth[quotes & 1]++; break;
+            case ']': case '}': depth[quotes & 1]--; break;
+            }
+        }
+        ch->quotes = quotes;
+        ch->depth[0] = depth[0];
+        ch->depth[1] = depth[1];
+    }
+}
+
+/* pass 2: from its known state, every chunk looks for its first comma of the root array */
+static void nfjson_chunk_split(void *arg, unsigned worker) {
+    nfjson_split *s = (nfjson_split *)arg;
+    nfjson_chunk *ch;
+    const char *p;
+    (void)worker;
+    while ((ch = nfjson_chunk_claim(s)) != NULL) {
+        int escaped = nfjson_chunk_escaped(s->begin, ch->start), in_string = ch->in_string;
+        ptrdiff_t depth = ch->depth_at;
+        ch->split = NULL;
+        for (p = ch->start; p < ch->end; p++) {//a cut past the end is the next chunk's to find
+            if (escaped) { escaped = 0; continue; }
+            switch (*p) {
+            case '\\': escaped = 1; break;
+            case '"': in_string ^= 1; break;
+            case '[': case '{': depth += !in_string; break;
+            case ']': case '}': depth -= !in_string; break;
+            case ',': if (!in_string && depth == 1) { ch->split = p; p = ch->end; } break;
+            }
+        }
+    }
+}
+
+static void nfjson_chunk_parse(void *arg, unsigned worker) {
+    nfjson_split *s = (nfjson_split *)arg;
+    nfjson_chunk *ch;
+    (void)worker;
+    while ((ch = nfjson_chunk_claim(s)) != NULL)
+        ch->status = nfjson_parse_elements(ch->start, ch->end - ch->start, s->opts, &ch->e, &ch->count);
+}
+
+#define ISWS(ch) ((ch) == ' ' || (ch) == '\n' || (ch) == '\r' || (ch) == '\t')
+
+int nfjson_parse_parallel(nfjson_pool *pool, nfjson_value *val, const char *json, size_t len,
+                                                            const nfjson_parse_options *opts) {
+    nfjson_split s;
+    const char *begin = json, *end = json + len, *cut;
+    size_t i, n, chunk, total;
+    int in_string = 0, parse_status = NFJSON_PARSE_OK;
+    ptrdiff_t depth = 1;
+    assert(NULL != val && (NULL != json || len == 0));
+    while (begin < end && ISWS(*begin)) begin++;
+    while (end > begin && ISWS(end[-1])) end--;
+    if (len < NFJSON_PARALLEL_MIN_SIZE || nfjson_pool_size(pool) == 1 || end - begin < 2 || *begin != '[' || end[-1] != ']')
+        return nfjson_parse_opts(val, json, len, opts);
+    s.begin = begin + 1;
+    s.end = end - 1;
+    s.opts = opts;
+    s.count = nfjson_pool_size(pool) * NFJSON_PARALLEL_CHUNKS;
+    chunk = (s.end - s.begin) / s.count;
+    if (chunk < NFJSON_PARALLEL_CHUNK_MIN) {
+        chunk = NFJSON_PARALLEL_CHUNK_MIN;
+        s.count = (s.end - s.begin) / chunk + 1;
+    }
+    s.chunks = (nfjson_chunk *)malloc(sizeof(nfjson_chunk) * s.count);
+    for (i = 0; i < s.count; i++) {
+        s.chunks[i].start = s.begin + i * chunk;
+        s.chunks[i].end = i + 1 == s.count ? s.end : s.begin + (i + 1) * chunk;
+    }
+    s.next = 0;
+    nfjson_pool_run(pool, nfjson_chunk_scan, &s);
+    for (i = 0; i < s.count; i++) {//prefix of the states, chunk by chunk
+        s.chunks[i].in_string = in_string;
+        s.chunks[i].depth_at = depth;
+        depth += s.chunks[i].depth[in_string];
+        in_string ^= (int)(s.chunks[i].quotes & 1);
+    }
+    s.next = 0;
+    nfjson_pool_run(pool, nfjson_chunk_split, &s);
+    /* one slice from every distinct cut, chunks without a cut of their own merge into the previous slice */
+    for (i = n = 0, cut = s.begin; i < s.count; i++) {
+        const char *split = s.chunks[i].split;
+        if (i > 0 && (split == NULL || split + 1 <= cut)) continue;
+        if (i == 0) split = s.begin - 1;
+        if (n > 0) s.chunks[n - 1].end = split;
+        s.chunks[n].start = cut = split + 1;
+        s.chunks[n].end = s.end;
+        n++;
+    }
+    s.count = n;
+    s.next = 0;
+    nfjson_pool_run(pool, nfjson_chunk_parse, &s);
+    for (i = total = 0; i < s.count; i++) {
+        total += s.chunks[i].count;
+        if (s.chunks[i].status != NFJSON_PARSE_OK) parse_status = s.chunks[i].status;
+    }
+    nfjson_init(val);
+    if (parse_status == NFJSON_PARSE_OK) {//stitch the runs
+        val->u.a.e = (nfjson_value *)malloc(sizeof(nfjson_value) * total);
+        val->u.a.len = total;
+        val->type = JSON_ARRAY;
+        for (i = total = 0; i < s.count; total += s.chunks[i++].count)
+            memcpy(val->u.a.e + total, s.chunks[i].e, sizeof(nfjson_value) * s.chunks[i].count);
+    }
+    else for (i = 0; i < s.count; i++) {
+        for (n = 0; n < s.chunks[i].count; n++) nfjson_free(s.chunks[i].e + n);
+    }
+    for (i = 0; i < s.count; i++) free(s.chunks[i].e);
+    free(s.chunks);
+    if (parse_status != NFJSON_PARSE_OK) return nfjson_parse_opts(val, json, len, opts);
+    return NFJSON_PARSE_OK;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include"pch.h"
+#include"notfastjson.h"
+#include"thread.h"
+
+/**
+*   a root array is cut between its elements and the slices are parsed on
+*   the workers of pool, the element runs are then stitched into one u.a.e.
+*   the cuts come from a quote-parity-aware scan run in parallel too, any
+*   other json, a small one or a NULL pool is handed to nfjson_parse_opts.
+*   the result and the status are those of nfjson_parse_opts, a json with
+*   an error is parsed again sequentially to report it exactly.
+**/
+#ifndef NFJSON_PARALLEL_MIN_SIZE
+#define NFJSON_PARALLEL_MIN_SIZE (1 << 20)
+#endif
+
+int nfjson_parse_parallel(nfjson_pool *pool, nfjson_value *val, const char *json, size_t len,
+                                                            const nfjson_parse_options *opts);
@@ -3,6 +3,12 @@
 #include"parse.h"
 #include"access.h"
 #include"memory.h"
+#include"simd.h"
+#include"number.h"
+#include"file.h"
+#include"projection.h"
+#include"utf8.h"
+#include"object.h"
 
 #ifndef NFJSON_PARSE_STACK_INIT_SIZE
 #define NFJSON_PARSE_STACK_INIT_SIZE 256
@@ -12,13 +18,22 @@ static void *nfjson_context_push(nfjson_context *c, size_t size) {
     if (c->top + size >= c->size) {//extend
         if (c->size == 0) c->size = NFJSON_PARSE_STACK_INIT_SIZE;
         while (c->top + size >= c->size) c->size += c->size >> 1;
-        c->stack = (char *)realloc(c->stack, c->size);
+        if (c->fixed && c->stack == c->fixed) {//leave the inline stack
+            c->stack = (char *)malloc(c->size);
+            memcpy(c->stack, c->fixed, c->top);
+        }
+        else c->stack = (char *)realloc(c->stack, c->size);
     }
     void *re = c->stack + c->top;
     c->top += size;
     return re;
 }
 
+/* nodes come from the document arena when there is one */
+static void *nfjson_context_alloc(nfjson_context *c, size_t size) {
+    return c->arena ? nfjson_arena_alloc(c->arena, size) : malloc(size);
+}
+
 #define PUSHC(c, ch) do{ *(char *)(nfjson_context_push(c, sizeof(char))) = (ch); }while(0)
 
 static void *nfjson_context_pop(nfjson_context *c, size_t size) {
@@ -26,6 +41,9 @@ static void *nfjson_context_pop(nfjson_context *c, size_t size) {
     return c->stack + (c->top -= size);
 }
 
+/* current byte, EOF at the end of the json */
+#define PEEK(c) ((c)->json < (c)->end ? (unsigned char)*(c)->json : EOF)
+
 /**
 *   ws = *(
 *       %x20 /      ; Space
@@ -33,15 +51,16 @@ static void *nfjson_context_pop(nfjson_context *c, size_t size) {
 *       %x0A /      ; Line feed or New line
 *       %x0D)       ;  Carriage return
 **/    
+#define ISWS(ch) ((ch) == ' ' || (ch) == '\n' || (ch) == '\r' || (ch) == '\t')
 static void nfjson_parse_whitespace(nfjson_context *c) {
-    const char *p = c->json;
-    while (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') p++;
+    const char *p = c->json, *end = c->end;
+    while (p < end && ISWS(*p)) p++;
     c->json = p;
 }
 
 /* null = "null" */
 static int nfjson_parse_null(nfjson_context *c, nfjson_value *val) {
-    if (c->json[0] == 'n' && c->json[1] == 'u' && c->json[2] == 'l' && c->json[3] == 'l') {
+    if (c->end - c->json >= 4 && c->json[0] == 'n' && c->json[1] == 'u' && c->json[2] == 'l' && c->json[3] == 'l') {
         c->json += 4;
         val->type = JSON_NULL;
         return NFJSON_PARSE_OK;
@@ -51,7 +70,7 @@ static int nfjson_parse_null(nfjson_context *c, nfjson_value *val) {
 
 /* true = "true" */
 static int nfjson_parse_true(nfjson_context *c, nfjson_value *val) {
-    if (c->json[0] == 't' && c->json[1] == 'r' && c->json[2] == 'u' && c->json[3] == 'e') {
+    if (c->end - c->json >= 4 && c->json[0] == 't' && c->json[1] == 'r' && c->json[2] == 'u' && c->json[3] == 'e') {
         c->json += 4;
         val->type = JSON_TRUE;
         return NFJSON_PARSE_OK;
@@ -61,7 +80,7 @@ static int nfjson_parse_true(nfjson_context *c, nfjson_value *val) {
 
 /* false = "false" */
 static int nfjson_parse_false(nfjson_context *c, nfjson_value *val) {
-    if (c->json[0] == 'f' && c->json[1] == 'a' && c->json[2] == 'l' && c->json[3] == 's' && c->json[4] == 'e') {
+    if (c->end - c->json >= 5 && c->json[0] == 'f' && c->json[1] == 'a' && c->json[2] == 'l' && c->json[3] == 's' && c->json[4] == 'e') {
         c->json += 5;
         val->type = JSON_FALSE;
         return NFJSON_PARSE_OK;
@@ -71,8 +90,8 @@ static int nfjson_parse_false(nfjson_context *c, nfjson_value *val) {
 
 /* null = "null" true = "true" false = "false" */
 static int nfjson_parse_literal(nfjson_context *c, nfjson_value *val, const char *literal, int json_type) {
-    const char *json = c->json;
-    while (*literal && *literal == *json) {
+    const char *json = c->json, *end = c->end;
+    while (*literal && json < end && *literal == *json) {
         literal++; json++;
     }
     if (*literal)return NFJSON_PARSE_INVALID_VALUE;
@@ -84,69 +103,20 @@ static int nfjson_parse_literal(nfjson_context *c, nfjson_value *val, const char
 #define ISDIGIT(ch)         ((ch) >= '0' && (ch) <= '9')
 #define ISDIGIT1TO9(ch)     ((ch) >= '1' && (ch) <= '9')
 #define ISHEXCHAR(ch)       ISDIGIT((ch))||((ch)>='A'&&(ch)<='F')||((ch)>='a'&&(ch)<='f')
-/**
-*   number = ["-"] int[frac][exp]
-*   int = "0" / digit1 - 9 * digit
-*   frac = "." 1 * digit
-*   exp = ("e" / "E")["-" / "+"] 1 * digit
-**/
+
 static int nfjson_parse_number(nfjson_context *c, nfjson_value *val) {
-    int parse_type = -1;
-    const char *test = c->json;
-    errno = 0;
-    if (*test == '-')test++;
-    if (ISDIGIT(*test)) {
-        if (*test == '0') {
-            test++; 
-            if (*test == '.') {
-                test++;
-                if (!(ISDIGIT(*test)))return NFJSON_PARSE_INVALID_VALUE;//0.
-                while (ISDIGIT(*test))test++;
-            }
-            else if (*test != 'e'&& *test != 'E' && *test != '\0' && *test != ' ' && *test != ',') {// ' ' & ',' for array
-                parse_type = NFJSON_PARSE_ROOT_NOT_SINGULAR; goto out; 
-            }//parse mostly valid text
-        }
-        else {
-            while (ISDIGIT(*test)) test++;
-            if (*test == '.') {
-                test++;
-                if (!(ISDIGIT(*test)))return NFJSON_PARSE_INVALID_VALUE;//num+.
-                while (ISDIGIT(*test))test++;
-            }
-        }
-        if (*test == 'e' || *test == 'E') {
-            test++;
-            if (*test == '+' || *test == '-')test++;
-            if (!(ISDIGIT(*test)) && *test != ' ' && *test != ',') { parse_type = NFJSON_PARSE_ROOT_NOT_SINGULAR; goto out; }
-            while (ISDIGIT(*test))test++;
-        }
-    } else return NFJSON_PARSE_INVALID_VALUE;
-out:
-    if (parse_type == NFJSON_PARSE_ROOT_NOT_SINGULAR) {
-        int len = (int)(test - (c->json));
-        char *num = malloc(sizeof(char)*(len + 1));
-        memcpy(num, c->json, len);
-        num[len] = 0;
-        nfjson_set_number(val, strtod(num, NULL));
-        free(num);
-        /*char *mod = test;
-        char ch = *mod;
-        printf("%s\n", c->json);
-        *mod = 0;
-        val->n = strtod(c->json, NULL);
-        *mod = ch;*/
-    }
-    else nfjson_set_number(val, strtod(c->json, NULL));
-    if (errno == ERANGE && (val->u.n == HUGE_VAL || val->u.n == -HUGE_VAL)) { nfjson_init(val); return NFJSON_PARSE_NUMBER_TOO_BIG; }
-    c->json = test;
-    return parse_type > 0 ? parse_type : NFJSON_PARSE_OK;
-}
-
-static char *nfjson_unicode_char2dec(const char *str, unsigned int *val) {
+    const char *stop;
+    int parse_status = nfjson_number_parse(c->json, c->end, &stop, val);
+    if (parse_status != NFJSON_PARSE_OK) return parse_status;
+    c->json = stop;
+    return NFJSON_PARSE_OK;
+}
+
+static char *nfjson_unicode_char2dec(const char *str, const char *end, unsigned int *val) {
     int i = 0;
     char ch;
     unsigned int u = 0;
+    if (end - str < 4) return NULL;
     do {
         ch = *str++;
         u = u << 4;
@@ -161,20 +131,21 @@ static char *nfjson_unicode_char2dec(const char *str, unsigned int *val) {
 }
 
 /* codepoint = 0x10000 + (H - 0xD800) × 0x400 + (L - 0xDC00) */
-static int nfjson_parse_unicode_char(const char **str, unsigned int *val) {
+static int nfjson_parse_unicode_char(const char **str, const char *end, unsigned int *val) {
     unsigned int H = 0, L = 0;
     const char *p = *str; 
-    p = nfjson_unicode_char2dec(p, &H);
+    p = nfjson_unicode_char2dec(p, end, &H);
     if (!p) return NFJSON_PARSE_INVALID_UNICODE_HEX;
     if (0xD800 <= H && H <= 0xDBFF) {
-        if(!(p[0] == '\\' && p[1] =='u'))
+        if(!(end - p >= 2 && p[0] == '\\' && p[1] =='u'))
             return NFJSON_PARSE_INVALID_UNICODE_SURROGATE;
         p += 2;
-        p = nfjson_unicode_char2dec(p, &L);
+        p = nfjson_unicode_char2dec(p, end, &L);
         if (!p || !(0xDC00 <= L && L <= 0xDFFF))
             return NFJSON_PARSE_INVALID_UNICODE_SURROGATE;
         *val = 0x10000 + (H - 0xD800) * 0x400 + (L - 0xDC00);
     }
+    else if (0xDC00 <= H && H <= 0xDFFF) return NFJSON_PARSE_INVALID_UNICODE_SURROGATE;//low half first, no pair
     else *val = H;
     *str = p;
     return NFJSON_PARSE_OK;
@@ -211,6 +182,63 @@ static int nfjson_encode_unicode_codepoint(nfjson_context *c, unsigned int cp) {
     else return 0;
 }
 
+#define SWAR_ONES 0x0101010101010101ULL
+#define SWAR_HIGHS 0x8080808080808080ULL
+/* some byte of w is below n, n <= 128 */
+#define SWAR_HASLESS(w, n) (((w) - SWAR_ONES * (n)) & ~(w) & SWAR_HIGHS)
+#define SWAR_HASZERO(w) SWAR_HASLESS(w, 1)
+
+/**
+*   first '"', '\\' or control char in [p, end), end if none. *high is left
+*   nonzero when a byte >= 0x80 may lie before it, blocks are marked whole
+**/
+static const char *nfjson_scan_string_high(const char *p, const char *end, size_t padding, unsigned int *high) {
+#if defined(NFJSON_AVX2)
+    const __m256i quote32 = _mm256_set1_epi8('"'), backslash32 = _mm256_set1_epi8('\\'), ctrl32 = _mm256_set1_epi8(0x1F);
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote32), _mm256_cmpeq_epi8(v, backslash32)),
+                                      _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctrl32), v));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(hit);
+        *high |= (unsigned int)_mm256_movemask_epi8(v);
+        if (mask) return p + nfjson_ctz32(mask);
+    }
+#endif
+#if defined(NFJSON_SSE2)
+    const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), ctrl = _mm_set1_epi8(0x1F);
+    while (p < end && (end - p >= 16 || padding >= (size_t)(16 - (end - p)))) {//the padded tail needs no byte loop
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                   _mm_cmpeq_epi8(_mm_min_epu8(v, ctrl), v));//v <= 0x1F
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(hit);
+        *high |= (unsigned int)_mm_movemask_epi8(v);
+        if (mask) {
+            p += nfjson_ctz32(mask);
+            return p < end ? p : end;
+        }
+        p += 16;
+    }
+    if (p >= end) return end;
+#endif
+    for (; end - p >= 8; p += 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        if (SWAR_HASZERO(w ^ (SWAR_ONES * '"')) | SWAR_HASZERO(w ^ (SWAR_ONES * '\\')) | SWAR_HASLESS(w, 0x20)) break;
+        *high |= (w & SWAR_HIGHS) != 0;
+    }
+    for (; p < end; p++) {
+        unsigned char ch = (unsigned char)*p;
+        if (ch == '"' || ch == '\\' || ch < 0x20) break;
+        *high |= ch & 0x80;
+    }
+    return p;
+}
+
+static const char *nfjson_scan_string(const char *p, const char *end, size_t padding) {
+    unsigned int high = 0;
+    return nfjson_scan_string_high(p, end, padding, &high);
+}
+
 /**
 *   string = quotation-mark *char quotation-mark
 *   char = unescaped /
@@ -228,21 +256,49 @@ static int nfjson_encode_unicode_codepoint(nfjson_context *c, unsigned int cp) {
 *   quotation-mark = %x22  ; "
 *   unescaped = %x20-21 / %x23-5B / %x5D-10FFFF
 **/
-static int nfjson_parse_string_raw(nfjson_context *c, char **s, size_t *len) {
+static int nfjson_parse_string_raw(nfjson_context *c, char **s, size_t *len, int *borrowed) {
     *s = NULL;
     *len = 0;
+    *borrowed = 0;
     size_t begin = c->top;
     int ch, parse_status;
-    unsigned int u;
-    const char *str = c->json + 1;
+    unsigned int u, high;
+    const char *str = c->json + 1, *end = c->end, *run;
     while (1) {
-        switch (ch = *str++) {
+        high = 0;
+        run = nfjson_scan_string_high(str, end, c->padding, &high);
+        if (high && c->utf8 && !nfjson_utf8_valid(str, run - str)) {//a sequence cut by an escape or the quote is malformed too
+            c->top = begin;
+            return NFJSON_PARSE_INVALID_UTF8;
+        }
+        if (c->strings != NFJSON_STRING_COPY && c->top == begin && run < end && *run == '"') {//no escape, refer to the json
+            *s = (char *)str;
+            *len = run - str;
+            *borrowed = 1;
+            if (c->strings == NFJSON_STRING_INSITU) *(char *)run = '\0';
+            c->json = run + 1;
+            return NFJSON_PARSE_OK;
+        }
+        if (run != str) {//copy the escape-free run at once
+            memcpy(nfjson_context_push(c, run - str), str, run - str);
+            str = run;
+        }
+        if (str == end) { c->top = begin; return NFJSON_PARSE_MISS_QUOTATION_MARK; }
+        switch (ch = (unsigned char)*str++) {
         case '"':
             *len = c->top - begin;
-            c->json = str;
             *s = nfjson_context_pop(c, *len);
+            if (c->strings == NFJSON_STRING_INSITU) {//unescaped text is never longer than the escaped one
+                char *dst = (char *)c->json + 1;
+                memcpy(dst, *s, *len);
+                dst[*len] = '\0';
+                *s = dst;
+                *borrowed = 1;
+            }
+            c->json = str;
             return NFJSON_PARSE_OK;
         case '\\':
+            if (str == end) { c->top = begin; return NFJSON_PARSE_MISS_QUOTATION_MARK; }
             switch (ch = *str++) {
             case '"':PUSHC(c, '\"'); break;
             case '\\':PUSHC(c, '\\'); break;
@@ -253,211 +309,1366 @@ static int nfjson_parse_string_raw(nfjson_context *c, char **s, size_t *len) {
             case 'r':PUSHC(c, '\r'); break;
             case 't':PUSHC(c, '\t'); break;
             case 'u':
-                parse_status = nfjson_parse_unicode_char(&str, &u);
+                parse_status = nfjson_parse_unicode_char(&str, end, &u);
                 if (parse_status == NFJSON_PARSE_OK) nfjson_encode_unicode_codepoint(c, u);
                 else { c->top = begin; return parse_status; }
                 break;
             default: c->top = begin; c->json = str; return NFJSON_PARSE_INVALID_STRING_ESCAPE;
             }break;
-        case '\0':c->top = begin; return NFJSON_PARSE_MISS_QUOTATION_MARK;
-        default:
-            if (ch < 0x20 || ch > 0x10ffff) { c->top = begin; return NFJSON_PARSE_INVALID_STRING_CHAR; }
-            PUSHC(c, ch);
-            break;
+        default:/* control char, '\0' included */
+            c->top = begin; return NFJSON_PARSE_INVALID_STRING_CHAR;
         }
     }
 }
 
-static int nfjson_parse_string(nfjson_context *c, nfjson_value *val) {
-    char *s;
-    size_t len;
-    int parse_status;
-    if((parse_status = nfjson_parse_string_raw(c, &s, &len)) == NFJSON_PARSE_OK)
-        nfjson_set_string(val, (const char *)s, len);
-    return parse_status;
+/**
+*   an open array or object of the machine. frames sit back to back at the
+*   bottom of the context stack, the innermost one at c->frame
+**/
+typedef struct {
+    size_t len;/* values so far */
+    nfjson_type type;/* JSON_ARRAY or JSON_OBJECT */
+}nfjson_frame;
+
+#define NFJSON_NO_FRAME ((size_t)-1)
+#define FRAME(c) ((nfjson_frame *)((c)->stack + (c)->frame))
+
+/* where the machine stands between two bytes, kept in c->state */
+enum {
+    NFJSON_STATE_VALUE,/* a value */
+    NFJSON_STATE_ARRAY,/* after '[' */
+    NFJSON_STATE_OBJECT,/* after '{' */
+    NFJSON_STATE_KEY,/* member name */
+    NFJSON_STATE_COLON,/* after the member name */
+    NFJSON_STATE_NEXT,/* after a value in a container */
+    NFJSON_STATE_ELEMENT,/* after ',' in an array */
+    NFJSON_STATE_DONE,/* root value complete */
+};
+
+/* what the end of the buffer means to nfjson_parse_run */
+enum {
+    NFJSON_RUN_LAST,/* end of the json */
+    NFJSON_RUN_MORE,/* more input follows, a token touching the end may go on */
+    NFJSON_RUN_TOKEN,/* more input follows, the buffer starts with a whole token */
+};
+#define NFJSON_PARSE_NEED_MORE (-1)/* internal, the buffer ran out before the root ended */
+#define NFJSON_PARSE_PAUSED (-2)/* internal, an event asked for c->pause */
+
+#define ISLETTER(ch)        (((ch) >= 'a' && (ch) <= 'z') || ((ch) >= 'A' && (ch) <= 'Z'))
+#define ISNUMCHAR(ch)       (ISDIGIT(ch) || (ch) == '-' || (ch) == '+' || (ch) == '.' || (ch) == 'e' || (ch) == 'E')
+
+/**
+*   end of the token that begins with kind, scanned from s on; NULL when it
+*   runs into end. *escape carries a trailing '\\' of a string across calls
+**/
+static const char *nfjson_token_scan(int kind, int *escape, const char *s, const char *end) {
+    if (kind == '"') {
+        for (; s < end; s++) {
+            if (*escape) *escape = 0;
+            else if (*s == '\\') *escape = 1;
+            else if (*s == '"') return s + 1;
+        }
+    }
+    else if (ISNUMCHAR(kind)) { while (s < end && ISNUMCHAR(*s)) s++; }
+    else while (s < end && ISLETTER(*s)) s++;
+    return s < end ? s : NULL;
 }
 
-static int nfjson_parse_value();
+/* the token parsed from start with parse_status may go on in the next chunk */
+static int nfjson_token_open(const char *start, const char *stop, const char *end, int parse_status) {
+    int escape = 0;
+    if (*start == '"') return parse_status != NFJSON_PARSE_OK && !nfjson_token_scan('"', &escape, start + 1, end);
+    if (ISNUMCHAR(*start)) return !nfjson_token_scan(*start, &escape, parse_status == NFJSON_PARSE_OK ? stop : start, end);
+    return parse_status != NFJSON_PARSE_OK && !nfjson_token_scan(*start, &escape, start, end);
+}
 
-/* array = %x5B ws [ value *( ws %x2C ws value ) ] ws %x5D */
-static int nfjson_parse_array(nfjson_context *c, nfjson_value *val) {
-    c->json++;
-    nfjson_parse_whitespace(c);
+/* value = null / false / true / number / string: a literal or number into *val, a string as *s, *len */
+static int nfjson_parse_scalar(nfjson_context *c, nfjson_value *val, char **s, size_t *len) {
+    switch (PEEK(c)) {
+    case 'n': return nfjson_parse_literal(c, val, "null", JSON_NULL);
+    case 't': return nfjson_parse_literal(c, val, "true", JSON_TRUE);
+    case 'f': return nfjson_parse_literal(c, val, "false", JSON_FALSE);
+    case '0':case '1':case '2':case '3':case '4':case '5':case '6':
+    case '7':case '8':case '9':case '-':
+        return nfjson_parse_number(c, val);
+    case '"':
+        val->type = JSON_STRING;
+        return nfjson_parse_string_raw(c, s, len, &c->borrowed);
+    case EOF: return NFJSON_PARSE_EXPECT_VALUE;
+    default:  return NFJSON_PARSE_INVALID_VALUE;
+    }
+}
+
+/* a callback left NULL takes the event and goes on */
+#define EMIT(c, event) (!(c)->sax->event || (c)->sax->event((c)->sax_ctx))
+#define EMIT_ARGS(c, event, ...) (!(c)->sax->event || (c)->sax->event((c)->sax_ctx, __VA_ARGS__))
+
+static int nfjson_emit_scalar(nfjson_context *c, const nfjson_value *val, const char *s, size_t len) {
+    switch (val->type) {
+    case JSON_NULL: return EMIT(c, null);
+    case JSON_FALSE: return EMIT_ARGS(c, boolean, 0);
+    case JSON_TRUE: return EMIT_ARGS(c, boolean, 1);
+    case JSON_NUMBER: return EMIT_ARGS(c, number, val);
+    default: return EMIT_ARGS(c, string, s, len);
+    }
+}
+
+/* pop the innermost frame and report its end */
+static int nfjson_parse_close(nfjson_context *c) {
+    nfjson_frame *f = FRAME(c);
+    size_t len = f->len;
+    nfjson_type type = f->type;
+    c->top = c->frame;
+    c->frame = --c->depth ? c->frame - sizeof(nfjson_frame) : NFJSON_NO_FRAME;
+    return type == JSON_ARRAY ? EMIT_ARGS(c, end_array, len) : EMIT_ARGS(c, end_object, len);
+}
+
+static void nfjson_parse_start(nfjson_context *c, const nfjson_sax_handler *handler, void *ctx) {
+    c->state = NFJSON_STATE_VALUE;
+    c->frame = NFJSON_NO_FRAME;
+    c->depth = 0;
+    c->sax = handler;
+    c->sax_ctx = ctx;
+}
+
+/**
+*   value  = false / null / true / object / array / number / string
+*   array  = %x5B ws [ value *( ws %x2C ws value ) ] ws %x5D
+*   member = string ws %x3A ws value
+*   object = %x7B ws [ member *( ws %x2C ws member ) ] ws %x7D
+*   iterative, reporting every value to c->sax as soon as it is known.
+*   nesting costs a frame on the context stack rather than native stack and
+*   is bounded by c->max_depth. all state lives in the context, so unless run
+*   is NFJSON_RUN_LAST the machine can stop at the end of the buffer with
+*   NFJSON_PARSE_NEED_MORE and go on with the next one, c->json is left on
+*   the first byte it could not consume. the same way an event setting
+*   c->pause returns NFJSON_PARSE_PAUSED right after it.
+**/
+static int nfjson_parse_run(nfjson_context *c, int run) {
+    nfjson_frame *f;
+    nfjson_value val;
+    const char *start;
+    char *s = NULL;
     size_t len = 0;
-    int parse_status = NFJSON_PARSE_OK;
-    if (*c->json == ',') { parse_status = NFJSON_PARSE_EXPECT_VALUE; c->json++; }
-    while (*c->json != ']') {
-        nfjson_value *v = (nfjson_value *)malloc(sizeof(nfjson_value));
-        nfjson_init(v);
-        parse_status = nfjson_parse_value(c, v);
-        if (parse_status == NFJSON_PARSE_OK) {
-            *(uintptr_t *)nfjson_context_push(c, sizeof(uintptr_t)) = (uintptr_t)v;
-            len++;
+    int ch, parse_status;
+    for (;;) {
+        if (c->pause) {
+            c->pause = 0;
+            return NFJSON_PARSE_PAUSED;
         }
-        else { free(v); break; }
         nfjson_parse_whitespace(c);
-        if (*c->json == ',') {
+        if (c->json == c->end && run != NFJSON_RUN_LAST && c->state != NFJSON_STATE_DONE) return NFJSON_PARSE_NEED_MORE;
+        switch (c->state) {
+        case NFJSON_STATE_VALUE:
+            ch = PEEK(c);
+            if (ch == '[' || ch == '{') {
+                if (c->depth == c->max_depth) { parse_status = NFJSON_PARSE_TOO_DEEP; goto error; }
+                c->frame = c->depth++ * sizeof(nfjson_frame);
+                f = (nfjson_frame *)nfjson_context_push(c, sizeof(nfjson_frame));
+                f->len = 0;
+                c->json++;
+                if (ch == '[') {
+                    f->type = JSON_ARRAY;
+                    c->state = NFJSON_STATE_ARRAY;
+                    if (!EMIT(c, start_array)) goto stop;
+                }
+                else {
+                    f->type = JSON_OBJECT;
+                    c->state = NFJSON_STATE_OBJECT;
+                    if (!EMIT(c, start_object)) goto stop;
+                }
+                continue;
+            }
+            start = c->json;
+            parse_status = nfjson_parse_scalar(c, &val, &s, &len);
+            if (run == NFJSON_RUN_MORE && nfjson_token_open(start, c->json, c->end, parse_status)) {
+                c->json = start;
+                return NFJSON_PARSE_NEED_MORE;
+            }
+            if (parse_status != NFJSON_PARSE_OK) goto error;
+            if (!nfjson_emit_scalar(c, &val, s, len)) goto stop;
+            break;
+        case NFJSON_STATE_ARRAY:
+            if (PEEK(c) == ',') { parse_status = NFJSON_PARSE_EXPECT_VALUE; goto error; }
+            if (PEEK(c) != ']') {
+                c->state = NFJSON_STATE_VALUE;
+                continue;
+            }
+            c->json++;//[]
+            if (!nfjson_parse_close(c)) goto stop;
+            break;
+        case NFJSON_STATE_OBJECT:
+            if (PEEK(c) == '}') {
+                c->json++;//{}
+                if (!nfjson_parse_close(c)) goto stop;
+                break;
+            }
+            c->state = NFJSON_STATE_KEY;
+            /* fall through */
+        case NFJSON_STATE_KEY:
+            if (PEEK(c) != '"') { parse_status = NFJSON_PARSE_MISS_KEY; goto error; }
+            start = c->json;
+            if ((parse_status = nfjson_parse_string_raw(c, &s, &len, &c->borrowed)) != NFJSON_PARSE_OK) {
+                if (run == NFJSON_RUN_MORE && nfjson_token_open(start, c->json, c->end, parse_status)) {
+                    c->json = start;
+                    return NFJSON_PARSE_NEED_MORE;
+                }
+                parse_status = NFJSON_PARSE_MISS_KEY;
+                goto error;
+            }
+            c->state = NFJSON_STATE_COLON;
+            if (!EMIT_ARGS(c, key, s, len)) goto stop;
+            continue;
+        case NFJSON_STATE_COLON:
+            if (PEEK(c) != ':') { parse_status = NFJSON_PARSE_MISS_COLON; goto error; }
+            c->json++;
+            c->state = NFJSON_STATE_VALUE;
+            continue;
+        case NFJSON_STATE_NEXT:
+            f = FRAME(c);
+            if (PEEK(c) == ',') {
+                c->json++;
+                c->state = f->type == JSON_ARRAY ? NFJSON_STATE_ELEMENT : NFJSON_STATE_KEY;
+                continue;
+            }
+            if (f->type == JSON_ARRAY && PEEK(c) != ']') { parse_status = NFJSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET; goto error; }
+            if (f->type == JSON_OBJECT && PEEK(c) != '}') { parse_status = NFJSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET; goto error; }
             c->json++;
-            nfjson_parse_whitespace(c);
-            if (*c->json == ']') { parse_status = NFJSON_EXTRA_COMMA; break; }
+            if (!nfjson_parse_close(c)) goto stop;
+            break;
+        case NFJSON_STATE_ELEMENT:
+            if (PEEK(c) == ']') { parse_status = NFJSON_EXTRA_COMMA; goto error; }
+            c->state = NFJSON_STATE_VALUE;
+            continue;
+        default:
+            return NFJSON_PARSE_OK;
         }
-        else if (*c->json != ']' || *c->json == '\0') {//value value
-            parse_status = NFJSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET; break;
+        /* a value is complete */
+        if (c->frame == NFJSON_NO_FRAME) {
+            c->state = NFJSON_STATE_DONE;
+            return NFJSON_PARSE_OK;
         }
+        FRAME(c)->len++;
+        c->state = NFJSON_STATE_NEXT;
     }
-    if (parse_status != NFJSON_PARSE_OK) {
-        if (len) for (; len > 0; len--) {
-            nfjson_value *nonuse = ((nfjson_value *)(*(uintptr_t *)nfjson_context_pop(c, sizeof(uintptr_t))));
-            nfjson_free(nonuse);
-            free(nonuse);
+stop:
+    parse_status = NFJSON_PARSE_STOPPED;
+error:
+    c->top = 0;
+    c->frame = NFJSON_NO_FRAME;
+    c->depth = 0;
+    c->state = NFJSON_STATE_DONE;
+    return parse_status;
+}
+
+/**
+*   the DOM is one client of the events, built bottom up. each open
+*   container has a build frame on the dom stack. array elements and object
+*   members are built right above their frame by value and moved out with
+*   one copy when the container closes. a value is attached to its
+*   container once it is complete.
+**/
+typedef struct {
+    nfjson_type type;/* JSON_ARRAY or JSON_OBJECT */
+    size_t len;/* elements or members above the frame */
+    size_t parent;/* offset of the enclosing frame */
+    nfjson_arena_mark mark;
+}nfjson_dom_frame;
+
+#define DOM_FRAME(d, off) ((nfjson_dom_frame *)((d)->stack + (off)))
+
+static void nfjson_dom_init(nfjson_dom *d, nfjson_context *c, nfjson_value *root) {
+    d->c = c;
+    d->root = root;
+    d->stack = NULL;
+    d->size = d->top = 0;
+    d->frame = NFJSON_NO_FRAME;
+    nfjson_arena_init(&d->keys);
+}
+
+static void nfjson_dom_free(nfjson_dom *d) {
+    free(d->stack);
+    nfjson_arena_free(&d->keys);
+}
+
+static void *nfjson_dom_push(nfjson_dom *d, size_t size) {
+    if (d->top + size > d->size) {
+        if (d->size == 0) d->size = NFJSON_PARSE_STACK_INIT_SIZE;
+        while (d->top + size > d->size) d->size += d->size >> 1;
+        d->stack = (char *)realloc(d->stack, d->size);
+    }
+    void *re = d->stack + d->top;
+    d->top += size;
+    return re;
+}
+
+/**
+*   where the next value goes: the root, the next element slot on the dom
+*   stack, or the member slot its key pushed. written before anything else
+*   is pushed, then attached
+**/
+static nfjson_value *nfjson_dom_value(nfjson_dom *d) {
+    nfjson_value *v;
+    if (d->frame == NFJSON_NO_FRAME) return d->root;
+    if (DOM_FRAME(d, d->frame)->type == JSON_OBJECT) return &((nfjson_member *)(d->stack + d->top) - 1)->val;
+    v = (nfjson_value *)nfjson_dom_push(d, sizeof(nfjson_value));
+    nfjson_init(v);
+    return v;
+}
+
+/* count the value written through nfjson_dom_value, it is already in its slot */
+static int nfjson_dom_attach(nfjson_dom *d) {
+    if (d->frame != NFJSON_NO_FRAME) DOM_FRAME(d, d->frame)->len++;
+    return 1;
+}
+
+static int nfjson_dom_null(void *ctx) {
+    nfjson_value *v = nfjson_dom_value((nfjson_dom *)ctx);
+    v->type = JSON_NULL;
+    return nfjson_dom_attach((nfjson_dom *)ctx);
+}
+
+static int nfjson_dom_boolean(void *ctx, int b) {
+    nfjson_value *v = nfjson_dom_value((nfjson_dom *)ctx);
+    v->type = b ? JSON_TRUE : JSON_FALSE;
+    return nfjson_dom_attach((nfjson_dom *)ctx);
+}
+
+static int nfjson_dom_number(void *ctx, const nfjson_value *num) {
+    nfjson_value *v = nfjson_dom_value((nfjson_dom *)ctx);
+    *v = *num;
+    return nfjson_dom_attach((nfjson_dom *)ctx);
+}
+
+/* borrowed text already lives in the json, see NFJSON_STRING_BORROW */
+static char *nfjson_dom_text(nfjson_context *c, const char *s, size_t len) {
+    char *text;
+    if (c->borrowed) return (char *)s;
+    text = (char *)nfjson_context_alloc(c, len + 1);
+    if (len) memcpy(text, s, len);
+    text[len] = 0;
+    return text;
+}
+
+static int nfjson_dom_string(void *ctx, const char *s, size_t len) {
+    nfjson_dom *d = (nfjson_dom *)ctx;
+    nfjson_value *v = nfjson_dom_value(d);
+    v->u.s.s = nfjson_dom_text(d->c, s, len);
+    v->u.s.len = len;
+    v->type = JSON_STRING;
+    return nfjson_dom_attach(d);
+}
+
+/* held until the object closes and copies it, see nfjson_object_new */
+static char *nfjson_dom_key_text(nfjson_dom *d, const char *s, size_t len) {
+    char *text;
+    if (d->c->arena) return nfjson_dom_text(d->c, s, len);
+    text = (char *)nfjson_arena_alloc(&d->keys, len);
+    if (len) memcpy(text, s, len);
+    return text;
+}
+
+static int nfjson_dom_key(void *ctx, const char *s, size_t len) {
+    nfjson_dom *d = (nfjson_dom *)ctx;
+    nfjson_member *m = (nfjson_member *)nfjson_dom_push(d, sizeof(nfjson_member));
+    m->key.s = nfjson_dom_key_text(d, s, len);
+    m->key.len = len;
+    nfjson_init(&m->val);
+    return 1;
+}
+
+/* the container itself gets its place once it is closed */
+static void nfjson_dom_open(nfjson_dom *d, int object) {
+    nfjson_context *c = d->c;
+    nfjson_arena_mark mark = nfjson_arena_get_mark(c->arena ? c->arena : &d->keys);
+    nfjson_dom_frame *f;
+    f = (nfjson_dom_frame *)nfjson_dom_push(d, sizeof(nfjson_dom_frame));
+    f->type = object ? JSON_OBJECT : JSON_ARRAY;
+    f->len = 0;
+    f->parent = d->frame;
+    f->mark = mark;
+    d->frame = (char *)f - d->stack;
+}
+
+static int nfjson_dom_start_array(void *ctx) {
+    nfjson_dom_open((nfjson_dom *)ctx, 0);
+    return 1;
+}
+
+static int nfjson_dom_start_object(void *ctx) {
+    nfjson_dom_open((nfjson_dom *)ctx, 1);
+    return 1;
+}
+
+/* end of either container, the element count is known from the frame */
+static int nfjson_dom_end(void *ctx, size_t count) {
+    nfjson_dom *d = (nfjson_dom *)ctx;
+    nfjson_dom_frame *f = DOM_FRAME(d, d->frame);
+    nfjson_value val, *v;
+    (void)count;//the frame counted the same
+    nfjson_init(&val);
+    if (f->type == JSON_OBJECT) {
+        val.u.o = nfjson_object_new(d->c->arena, (nfjson_member *)(f + 1), f->len);
+        val.type = JSON_OBJECT;
+        if (!d->c->arena) nfjson_arena_rollback(&d->keys, f->mark);
+    }
+    else {
+        val.u.a.len = f->len;
+        val.u.a.e = NULL;
+        if (f->len) {
+            val.u.a.e = (nfjson_value *)nfjson_context_alloc(d->c, sizeof(nfjson_value) * f->len);
+            memcpy(val.u.a.e, f + 1, sizeof(nfjson_value) * f->len);
         }
-    }else{
-        c->json++;
-        val->u.a.len = len;
-        /*nfjson_value *array[] = malloc(sizeof(nfjson_value *)*len);*/ //expect continuous memory
-        if (len) {
-            nfjson_value *array = malloc(sizeof(nfjson_value)*len);
-            memset(array, 0, sizeof(nfjson_value)*len);
-            for (; len; len--) {
-                //expect continuous memory
-                /* *(array + len - 1) = (nfjson_value *)nfjson_context_pop(c, sizeof(uintptr_t)); */
-                nfjson_value *vp = (nfjson_value *)(*(uintptr_t *)nfjson_context_pop(c, sizeof(uintptr_t)));
-                *(array + len - 1) = *vp;
-                free(vp);
-            }
-            val->u.a.e = array;
+        val.type = JSON_ARRAY;
+    }
+    d->top = d->frame;
+    d->frame = f->parent;
+    v = nfjson_dom_value(d);//may reuse the bytes of f
+    *v = val;
+    return nfjson_dom_attach(d);
+}
+
+/* release every open container after a failed parse, from the innermost out */
+static void nfjson_dom_unwind(nfjson_dom *d) {
+    size_t frame, bottom = d->frame, top = d->top, i;
+    for (frame = d->frame; frame != NFJSON_NO_FRAME; frame = DOM_FRAME(d, frame)->parent) {
+        nfjson_dom_frame *f = DOM_FRAME(d, frame);
+        bottom = frame;
+        if (d->c->arena) continue;//dropped at once below
+        if (f->type == JSON_OBJECT) {//a key waiting for its value has a slot too
+            nfjson_member *m = (nfjson_member *)(f + 1);
+            for (i = 0; m + i < (nfjson_member *)(d->stack + top); i++) nfjson_free(&m[i].val);
         }
-        else val->u.a.e = NULL;
-        val->type = JSON_ARRAY;
+        else for (i = 0; i < f->len; i++) nfjson_free((nfjson_value *)(f + 1) + i);
+        top = frame;
     }
-    return parse_status;
+    if (bottom == NFJSON_NO_FRAME) return;
+    nfjson_arena_rollback(d->c->arena ? d->c->arena : &d->keys, DOM_FRAME(d, bottom)->mark);
+    d->top = 0;
+    d->frame = NFJSON_NO_FRAME;
 }
 
-static unsigned int nfjson_string_hashcode(nfjson_string *key) {//this func can not tell {"n\0", 1} & {"n\0", 2}, however, {"n\0", 1} may considered illegal
-    unsigned int hash = 0;
-    int i;
-    char *s = key->s;
-    for (i = (int)key->len; i >= 0; i--) {
-        hash = hash * 33 + s[i];
+static const nfjson_sax_handler nfjson_dom_handler = {
+    nfjson_dom_null, nfjson_dom_boolean, nfjson_dom_number, nfjson_dom_string, nfjson_dom_key,
+    nfjson_dom_start_object, nfjson_dom_end, nfjson_dom_start_array, nfjson_dom_end
+};
+
+#ifndef NFJSON_PARSE_STACK_INLINE
+#define NFJSON_PARSE_STACK_INLINE 1024
+#endif
+/* run c->sax over the whole json, only whitespace may follow the root. a warm c->stack is kept */
+static int nfjson_parse_events(nfjson_context *c, int warm) {
+    char stack[NFJSON_PARSE_STACK_INLINE];//shallow json never touches the heap
+    int parse_status;
+    if (!warm) {
+        c->stack = c->fixed = stack;
+        c->size = sizeof(stack);
+    }
+    parse_status = nfjson_parse_run(c, NFJSON_RUN_LAST);
+    if (parse_status == NFJSON_PARSE_OK){
+        nfjson_parse_whitespace(c);
+        if(c->json != c->end) parse_status = NFJSON_PARSE_ROOT_NOT_SINGULAR;
     }
-    return hash;
+    assert(c->top == 0);
+    if (!warm) {
+        if (c->stack != c->fixed) free(c->stack);
+        c->stack = c->fixed = NULL;
+        c->size = 0;
+    }
+    return parse_status;
 }
 
-//look up key "abc\0abc" matches "abc\0", cmp thr len
-static int cmp_nfjson_string_key(const nfjson_string *k, const nfjson_string *key) {
-    return k->len == key->len && memcmp(k->s, key->s, k->len) == 0;
+static int nfjson_parse_root(nfjson_context *c, nfjson_value *val) {
+    nfjson_dom dom;
+    int parse_status;
+    nfjson_init(val);
+    nfjson_dom_init(&dom, c, val);
+    nfjson_parse_start(c, &nfjson_dom_handler, &dom);
+    parse_status = nfjson_parse_events(c, 0);
+    nfjson_dom_unwind(&dom);//what a failed parse left open
+    nfjson_dom_free(&dom);
+    return parse_status;
 }
 
-static void nfjson_value_free(nfjson_value *val) {
-    nfjson_free(val);
-    free(val);
+static void nfjson_context_init(nfjson_context *c, const char *json, size_t len, nfjson_arena *arena) {
+    c->json = json;
+    c->end = json + len;
+    c->padding = 0;
+    c->stack = NULL;
+    c->size = 0;
+    c->top = 0;
+    c->arena = arena;
+    c->strings = NFJSON_STRING_COPY;
+    c->max_depth = NFJSON_PARSE_MAX_DEPTH;
+    c->fixed = NULL;
+    c->sax = NULL;
+    c->sax_ctx = NULL;
+    c->borrowed = 0;
+    c->pause = 0;
+    c->utf8 = 1;
 }
 
-static int nfjson_parse_nfjson_string(nfjson_context *c, nfjson_string *str) {
-    str->s = NULL;
-    str->len = 0;
-    char *s;
+static void nfjson_context_options(nfjson_context *c, const nfjson_parse_options *opts) {
+    if (opts && opts->max_depth) c->max_depth = opts->max_depth;
+    if (opts && opts->skip_utf8) c->utf8 = 0;
+}
+
+int nfjson_parse(nfjson_value *val, const char *json) {
+    assert(NULL != val && NULL != json);
+    return nfjson_parse_n(val, json, strlen(json));
+}
+
+int nfjson_parse_n(nfjson_value *val, const char *json, size_t len) {
+    assert(NULL != val && (NULL != json || len == 0));
+    nfjson_context context;
+    nfjson_context_init(&context, json, len, NULL);
+    return nfjson_parse_root(&context, val);
+}
+
+int nfjson_parse_opts(nfjson_value *val, const char *json, size_t len, const nfjson_parse_options *opts) {
+    assert(NULL != val && (NULL != json || len == 0));
+    nfjson_context context;
+    nfjson_context_init(&context, json, len, NULL);
+    nfjson_context_options(&context, opts);
+    return nfjson_parse_root(&context, val);
+}
+
+int nfjson_parse_padded(nfjson_value *val, const char *json, size_t len) {
+    assert(NULL != val && NULL != json);
+    nfjson_context context;
+    nfjson_context_init(&context, json, len, NULL);
+    context.padding = NFJSON_PADDING;
+    return nfjson_parse_root(&context, val);
+}
+
+/**
+*   report every value of json to handler in document order instead of
+*   building it, no node is allocated. a callback returning 0 stops the
+*   parse with NFJSON_PARSE_STOPPED. strings and keys are only valid during
+*   the callback
+**/
+int nfjson_parse_sax(const nfjson_sax_handler *handler, void *ctx, const char *json, size_t len,
+                                                            const nfjson_parse_options *opts) {
+    assert(NULL != handler && (NULL != json || len == 0));
+    nfjson_context context;
+    nfjson_context_init(&context, json, len, NULL);
+    nfjson_context_options(&context, opts);
+    context.strings = NFJSON_STRING_BORROW;//json outlives every callback
+    nfjson_parse_start(&context, handler, ctx);
+    return nfjson_parse_events(&context, 0);
+}
+
+int nfjson_parse_file(nfjson_value *val, const char *path, const nfjson_parse_options *opts) {
+    assert(NULL != val && NULL != path);
+    nfjson_context context;
+    nfjson_file f;
+    int parse_status;
+    nfjson_init(val);
+    if (nfjson_file_map(&f, path) != 0) return NFJSON_PARSE_IO_ERROR;
+    nfjson_context_init(&context, f.data, f.len, NULL);
+    nfjson_context_options(&context, opts);
+    context.padding = f.padding;
+    parse_status = nfjson_parse_root(&context, val);
+    nfjson_file_unmap(&f);
+    return parse_status;
+}
+
+int nfjson_parse_document_file(nfjson_document *doc, const char *path, const nfjson_parse_options *opts) {
+    assert(NULL != doc && NULL != path);
+    nfjson_context context;
+    nfjson_file f;
+    int parse_status;
+    nfjson_arena_init(&doc->arena);
+    nfjson_init(&doc->root);
+    if (nfjson_file_map(&f, path) != 0) return NFJSON_PARSE_IO_ERROR;
+    nfjson_context_init(&context, f.data, f.len, &doc->arena);
+    nfjson_context_options(&context, opts);
+    context.padding = f.padding;
+    parse_status = nfjson_parse_root(&context, &doc->root);
+    if (doc->root.type == JSON_UNRESOLVED) nfjson_arena_free(&doc->arena);
+    nfjson_file_unmap(&f);
+    return parse_status;
+}
+
+/* parse into doc, release with nfjson_document_free */
+int nfjson_parse_document(nfjson_document *doc, const char *json) {
+    assert(NULL != json);
+    return nfjson_parse_document_n(doc, json, strlen(json));
+}
+
+static int nfjson_parse_document_strings(nfjson_document *doc, const char *json, size_t len, int strings,
+                                                            const nfjson_parse_options *opts) {
+    assert(NULL != doc && (NULL != json || len == 0));
+    nfjson_context context;
+    nfjson_context_init(&context, json, len, &doc->arena);
+    nfjson_context_options(&context, opts);
+    context.strings = strings;
+    nfjson_arena_init(&doc->arena);
+    int parse_status = nfjson_parse_root(&context, &doc->root);
+    if (doc->root.type == JSON_UNRESOLVED) nfjson_arena_free(&doc->arena);
+    return parse_status;
+}
+
+int nfjson_parse_document_n(nfjson_document *doc, const char *json, size_t len) {
+    return nfjson_parse_document_strings(doc, json, len, NFJSON_STRING_COPY, NULL);
+}
+
+int nfjson_parse_document_opts(nfjson_document *doc, const char *json, size_t len, const nfjson_parse_options *opts) {
+    return nfjson_parse_document_strings(doc, json, len, NFJSON_STRING_COPY, opts);
+}
+
+/* strings without escapes point into json and are not '\0' terminated, json must outlive doc */
+int nfjson_parse_document_borrowed(nfjson_document *doc, const char *json, size_t len) {
+    return nfjson_parse_document_strings(doc, json, len, NFJSON_STRING_BORROW, NULL);
+}
+
+/* every string is unescaped and '\0' terminated inside json, json must outlive doc */
+int nfjson_parse_document_insitu(nfjson_document *doc, char *json, size_t len) {
+    return nfjson_parse_document_strings(doc, json, len, NFJSON_STRING_INSITU, NULL);
+}
+
+/**
+*   value *( ws %x2C ws value ), the inside of an array with the brackets cut
+*   off, as a run of elements by value into *e (malloc, NULL when nothing
+*   parsed). nesting counts the array around them. see nfjson_parse_parallel
+**/
+int nfjson_parse_elements(const char *json, size_t len, const nfjson_parse_options *opts, nfjson_value **e, size_t *count) {
+    nfjson_context c;
+    nfjson_dom dom;
+    nfjson_value v, *run = NULL;
+    size_t n = 0, size = 0, i;
     int parse_status;
-    if ((parse_status = nfjson_parse_string_raw(c, &s, &str->len)) == NFJSON_PARSE_OK) {
-        str->s = malloc(sizeof(char)*(str->len + 1));
-        memcpy(str->s, s, str->len);
-        str->s[str->len] = 0;
+    assert(NULL != e && NULL != count && (NULL != json || len == 0));
+    nfjson_context_init(&c, json, len, NULL);
+    nfjson_context_options(&c, opts);
+    c.max_depth--;
+    nfjson_dom_init(&dom, &c, &v);
+    for (;;) {
+        nfjson_init(&v);
+        nfjson_parse_start(&c, &nfjson_dom_handler, &dom);
+        if ((parse_status = nfjson_parse_run(&c, NFJSON_RUN_LAST)) != NFJSON_PARSE_OK) {
+            nfjson_dom_unwind(&dom);
+            break;
+        }
+        if (n == size) {
+            size = size ? size + (size >> 1) : NFJSON_PARSE_STACK_INIT_SIZE;
+            run = (nfjson_value *)realloc(run, sizeof(nfjson_value) * size);
+        }
+        run[n++] = v;
+        nfjson_parse_whitespace(&c);
+        if (c.json == c.end) break;
+        if (*c.json != ',') {
+            parse_status = NFJSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+            break;
+        }
+        c.json++;
+    }
+    if (parse_status != NFJSON_PARSE_OK) {
+        for (i = 0; i < n; i++) nfjson_free(run + i);
+        free(run);
+        run = NULL;
+        n = 0;
     }
+    nfjson_dom_free(&dom);
+    free(c.stack);
+    *e = run;
+    *count = n;
     return parse_status;
 }
 
 /**
-*   member = string ws %x3A ws value
-*   object = %x7B ws [ member *( ws %x2C ws member ) ] ws %x7D
+*   lazy documents: below the root every value starts as a JSON_LAZY stub
+*   holding its first byte in the already validated json. resolving decodes
+*   a scalar completely, an array or object down to stubs of its children
+*   and skips over their text without checking it again.
 **/
-static int nfjson_parse_object(nfjson_context *c, nfjson_value *val) {
+struct nfjson_lazy {
+    const char *end;/* end of the json */
+    nfjson_arena *arena;/* owner of the decoded nodes */
+};
+
+static const nfjson_sax_handler nfjson_check_handler;/* no callbacks, validation only */
+
+static void nfjson_lazy_stub(nfjson_value *v, const char *json, const nfjson_lazy *lazy) {
+    v->type = JSON_LAZY;
+    v->u.lazy.json = json;
+    v->u.lazy.doc = lazy;
+}
+
+/* inside a valid container, a non-whitespace byte always follows */
+static const char *nfjson_lazy_whitespace(const char *p) {
+    while (ISWS(*p)) p++;
+    return p;
+}
+
+/* end of the valid value at p */
+static const char *nfjson_lazy_skip(const char *p, const char *end) {
+    size_t depth = 0;
+    int escape = 0;
+    do {
+        if (*p == '"') {
+            for (p++; *(p = nfjson_scan_string(p, end, 0)) != '"'; p += 2);//only escapes stop the scan in valid json
+            p++;
+        }
+        else if (*p == '[' || *p == '{') { depth++; p++; }
+        else if (*p == ']' || *p == '}') { depth--; p++; }
+        else if (ISNUMCHAR(*p) || ISLETTER(*p)) {
+            const char *stop = nfjson_token_scan(*p, &escape, p, end);
+            p = stop ? stop : end;
+        }
+        else p++;//whitespace, ',' and ':'
+    } while (depth);
+    return p;
+}
+
+static void nfjson_lazy_open_array(nfjson_context *c, nfjson_value *v, const char *p) {
+    const nfjson_lazy *lazy = v->u.lazy.doc;
+    size_t len = 0;
+    v->u.a.e = NULL;
+    if (*(p = nfjson_lazy_whitespace(p)) != ']') {
+        for (;;) {
+            nfjson_lazy_stub((nfjson_value *)nfjson_context_push(c, sizeof(nfjson_value)), p, lazy);
+            len++;
+            p = nfjson_lazy_whitespace(nfjson_lazy_skip(p, lazy->end));
+            if (*p == ']') break;
+            p = nfjson_lazy_whitespace(p + 1);
+        }
+        v->u.a.e = (nfjson_value *)nfjson_context_alloc(c, sizeof(nfjson_value) * len);
+        memcpy(v->u.a.e, c->stack, sizeof(nfjson_value) * len);
+    }
+    v->u.a.len = len;
+    v->type = JSON_ARRAY;
+}
+
+static void nfjson_lazy_open_object(nfjson_context *c, nfjson_value *v, const char *p) {
+    const nfjson_lazy *lazy = v->u.lazy.doc;
+    nfjson_member *m;
+    char *s, *text;
+    size_t len, count = 0;
+    if (*(p = nfjson_lazy_whitespace(p)) != '}') {
+        for (;;) {
+            c->json = p;
+            nfjson_parse_string_raw(c, &s, &len, &c->borrowed);
+            text = nfjson_dom_text(c, s, len);//before the member is pushed over an unescaped key
+            p = nfjson_lazy_whitespace(nfjson_lazy_whitespace(c->json) + 1);//':'
+            m = (nfjson_member *)nfjson_context_push(c, sizeof(nfjson_member));
+            m->key.s = text;
+            m->key.len = len;
+            nfjson_lazy_stub(&m->val, p, lazy);
+            count++;
+            p = nfjson_lazy_whitespace(nfjson_lazy_skip(p, lazy->end));
+            if (*p == '}') break;
+            p = nfjson_lazy_whitespace(p + 1);
+        }
+    }
+    v->u.o = nfjson_object_new(c->arena, (nfjson_member *)c->stack, count);//a repeated key keeps the first name and the last value, as parsed
+    v->type = JSON_OBJECT;
+}
+
+/* decode val in place if it is still a JSON_LAZY stub */
+nfjson_value *nfjson_lazy_resolve(nfjson_value *val) {
+    nfjson_context c;
+    const char *p;
+    char *s;
+    size_t len;
+    assert(NULL != val);
+    if (val->type != JSON_LAZY) return val;
+    p = val->u.lazy.json;
+    nfjson_context_init(&c, p, val->u.lazy.doc->end - p, val->u.lazy.doc->arena);
+    c.utf8 = 0;//checked with the whole json, strings are copied into the arena and terminated
+    if (*p == '[') nfjson_lazy_open_array(&c, val, p + 1);
+    else if (*p == '{') nfjson_lazy_open_object(&c, val, p + 1);
+    else if (nfjson_parse_scalar(&c, val, &s, &len) == NFJSON_PARSE_OK && val->type == JSON_STRING) {
+        val->u.s.s = nfjson_dom_text(&c, s, len);
+        val->u.s.len = len;
+    }
+    free(c.stack);
+    return val;
+}
+
+int nfjson_parse_document_lazy(nfjson_document *doc, const char *json, size_t len) {
+    assert(NULL != doc && (NULL != json || len == 0));
+    nfjson_context context;
+    nfjson_lazy *lazy;
+    int parse_status;
+    nfjson_context_init(&context, json, len, NULL);
+    context.strings = NFJSON_STRING_BORROW;//nothing is kept
+    nfjson_parse_start(&context, &nfjson_check_handler, NULL);
+    nfjson_arena_init(&doc->arena);
+    nfjson_init(&doc->root);
+    if ((parse_status = nfjson_parse_events(&context, 0)) != NFJSON_PARSE_OK) return parse_status;
+    lazy = (nfjson_lazy *)nfjson_arena_alloc(&doc->arena, sizeof(nfjson_lazy));
+    lazy->end = json + len;
+    lazy->arena = &doc->arena;
+    context.json = json;
+    nfjson_parse_whitespace(&context);
+    nfjson_lazy_stub(&doc->root, context.json, lazy);
+    nfjson_lazy_resolve(&doc->root);
+    return NFJSON_PARSE_OK;
+}
+
+/**
+*   projection: a walk down the paths recursing once per path level. a
+*   value no path goes into is skipped without recursion, a value a path
+*   ends on is built by the event parser like any json
+**/
+typedef struct {
+    nfjson_context *c;
+    nfjson_dom dom;/*builds the values a path ends on*/
+    const nfjson_projection *proj;
+    const nfjson_projection_node **set;/*the node set of each depth, sliced by proj->level*/
+    size_t max_depth;
+    nfjson_value *e;/*elements of the open arrays, the context stack belongs to the event parser*/
+    size_t size, top;
+    nfjson_member *m;/*members of the open objects*/
+    size_t m_size, m_top;
+}nfjson_project;
+
+/* past the value at c->json, checking only where strings end and that brackets balance */
+static int nfjson_project_skip(nfjson_context *c) {
+    const char *p = c->json, *end = c->end, *start;
+    size_t depth = 0;
+    for (;;) {
+        if (p == end) {
+            if (depth == 0) return NFJSON_PARSE_EXPECT_VALUE;
+            return *c->json == '[' ? NFJSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : NFJSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+        }
+        switch (*p) {
+        case '"':
+            for (p++; (p = nfjson_scan_string(p, end, c->padding)) < end && *p != '"'; p++)
+                if (*p == '\\' && ++p == end) break;
+            if (p == end) return NFJSON_PARSE_MISS_QUOTATION_MARK;
+            p++;
+            break;
+        case '[': case '{':
+            depth++;
+            p++;
+            break;
+        case ']': case '}':
+            if (depth == 0) return NFJSON_PARSE_INVALID_VALUE;
+            depth--;
+            p++;
+            break;
+        default:
+            if (depth) { p++; break; }
+            for (start = p; p < end && !ISWS(*p) && *p != ',' && *p != ']' && *p != '}' && *p != ':'; p++);
+            if (p == start) return NFJSON_PARSE_INVALID_VALUE;
+        }
+        if (depth == 0) {
+            c->json = p;
+            return NFJSON_PARSE_OK;
+        }
+    }
+}
+
+/* a path ends on the value at c->json, parse it whole into v */
+static int nfjson_project_leaf(nfjson_project *w, nfjson_value *v, size_t depth) {
+    nfjson_context *c = w->c;
+    int parse_status;
+    w->dom.root = v;
+    c->max_depth = w->max_depth - depth;
+    nfjson_parse_start(c, &nfjson_dom_handler, &w->dom);
+    if ((parse_status = nfjson_parse_run(c, NFJSON_RUN_LAST)) != NFJSON_PARSE_OK) nfjson_dom_unwind(&w->dom);
+    return parse_status;
+}
+
+static int nfjson_project_value(nfjson_project *w, nfjson_value *v, size_t depth, size_t n);
+
+/* the members kept are moved into the object once it closes, a failed parse included */
+static int nfjson_project_object(nfjson_project *w, nfjson_value *v, size_t depth, size_t n) {
+    nfjson_context *c = w->c;
+    const nfjson_projection_node **set = w->set + w->proj->level[depth], **next = w->set + w->proj->level[depth + 1];
+    nfjson_member member;
+    nfjson_arena_mark mark = nfjson_arena_get_mark(&w->dom.keys);
+    char *s;
+    size_t base = w->m_top, len, m;
+    int parse_status = NFJSON_PARSE_OK;
+    if (depth == w->max_depth) return NFJSON_PARSE_TOO_DEEP;
     c->json++;
     nfjson_parse_whitespace(c);
-    int parse_status = NFJSON_PARSE_OK;// {}
-    char *s = NULL;
-    nfjson_string *key;
-    nfjson_value *value;
-    void *old_val = NULL;
-    hash_table *ht = new_hash_table(8, nfjson_string_hashcode, 
-                                                            cmp_nfjson_string_key, nfjson_string_free, nfjson_value_free);
-    while (*c->json != '}' && *c->json != '\0') {
-        if (*c->json != '"') { parse_status = NFJSON_PARSE_MISS_KEY; break; }
-        key = malloc(sizeof(nfjson_string));
-        parse_status = nfjson_parse_nfjson_string(c, key);
-        if (parse_status != NFJSON_PARSE_OK) { nfjson_string_free(key); parse_status = NFJSON_PARSE_MISS_KEY; break; }
+    if (PEEK(c) == '}') c->json++;
+    else for (;;) {
+        if (PEEK(c) != '"' || nfjson_parse_string_raw(c, &s, &len, &c->borrowed) != NFJSON_PARSE_OK) {
+            parse_status = NFJSON_PARSE_MISS_KEY;
+            break;
+        }
+        member.key.s = NULL;
+        if ((m = nfjson_projection_member(set, n, s, len, next))) {//copied before the stack is used again
+            member.key.s = nfjson_dom_key_text(&w->dom, s, len);
+            member.key.len = len;
+        }
         nfjson_parse_whitespace(c);
-        if (*c->json++ != ':') {
-            parse_status = NFJSON_PARSE_MISS_COLON; nfjson_string_free(key); break;
+        if (PEEK(c) != ':') {
+            parse_status = NFJSON_PARSE_MISS_COLON;
+            break;
         }
+        c->json++;
         nfjson_parse_whitespace(c);
-        value = malloc(sizeof(nfjson_value));
-        nfjson_init(value);
-        parse_status = nfjson_parse_value(c, value);
-        if (parse_status != NFJSON_PARSE_OK) { nfjson_string_free(key); nfjson_free(value); free(value); break; }
-        if (old_val = hash_table_put(ht, key, value)) { nfjson_free(old_val); free(old_val); }//repeated key
+        nfjson_init(&member.val);
+        parse_status = m ? nfjson_project_value(w, &member.val, depth + 1, m) : nfjson_project_skip(c);
+        if (member.key.s) {//taking nothing still drops what a repeated key took, see nfjson_object_new
+            if (w->m_top == w->m_size) {
+                w->m_size = w->m_size ? w->m_size + (w->m_size >> 1) : NFJSON_PARSE_STACK_INIT_SIZE;
+                w->m = (nfjson_member *)realloc(w->m, sizeof(nfjson_member) * w->m_size);
+            }
+            w->m[w->m_top++] = member;
+        }
+        if (parse_status != NFJSON_PARSE_OK) break;
         nfjson_parse_whitespace(c);
-        if (*c->json == '}') { break; }
-        else if (*c->json == ',') {
+        if (PEEK(c) == '}') {
             c->json++;
-            nfjson_parse_whitespace(c);
-            if (*c->json == '}' || *c->json == '\0') { parse_status = NFJSON_PARSE_MISS_KEY; break; }
-        } else { parse_status = NFJSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET; break; }
+            break;
+        }
+        if (PEEK(c) != ',') { parse_status = NFJSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET; break; }
+        c->json++;
+        nfjson_parse_whitespace(c);
     }
-    if (*c->json == '}') c->json++;
-    if (parse_status != NFJSON_PARSE_OK) {
-        hash_table_free(ht);
-    } else {
-        val->u.ht = ht;
-        val->type = JSON_OBJECT;
+    v->u.o = nfjson_object_new(c->arena, w->m + base, w->m_top - base);
+    v->type = JSON_OBJECT;
+    w->m_top = base;
+    if (!c->arena) nfjson_arena_rollback(&w->dom.keys, mark);
+    return parse_status;
+}
+
+static int nfjson_project_array(nfjson_project *w, nfjson_value *v, size_t depth, size_t n) {
+    nfjson_context *c = w->c;
+    const nfjson_projection_node **set = w->set + w->proj->level[depth], **next = w->set + w->proj->level[depth + 1];
+    nfjson_value e;
+    size_t base = w->top, len = 0, m;
+    int parse_status = NFJSON_PARSE_OK;
+    if (depth == w->max_depth) return NFJSON_PARSE_TOO_DEEP;
+    c->json++;
+    nfjson_parse_whitespace(c);
+    if (PEEK(c) == ']') c->json++;
+    else for (;;) {
+        if (PEEK(c) == ',') { parse_status = len ? NFJSON_PARSE_INVALID_VALUE : NFJSON_PARSE_EXPECT_VALUE; break; }
+        if (PEEK(c) == ']') { parse_status = NFJSON_EXTRA_COMMA; break; }
+        nfjson_init(&e);
+        m = nfjson_projection_element(set, n, len, next);
+        parse_status = m ? nfjson_project_value(w, &e, depth + 1, m) : nfjson_project_skip(c);
+        if (w->top == w->size) {
+            w->size = w->size ? w->size + (w->size >> 1) : NFJSON_PARSE_STACK_INIT_SIZE;
+            w->e = (nfjson_value *)realloc(w->e, sizeof(nfjson_value) * w->size);
+        }
+        w->e[w->top++] = e;
+        len++;
+        if (parse_status != NFJSON_PARSE_OK) break;
+        nfjson_parse_whitespace(c);
+        if (PEEK(c) == ']') {
+            c->json++;
+            break;
+        }
+        if (PEEK(c) != ',') { parse_status = NFJSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET; break; }
+        c->json++;
+        nfjson_parse_whitespace(c);
+    }
+    v->u.a.len = len;
+    v->u.a.e = NULL;
+    if (len) {
+        v->u.a.e = (nfjson_value *)nfjson_context_alloc(c, sizeof(nfjson_value) * len);
+        memcpy(v->u.a.e, w->e + base, sizeof(nfjson_value) * len);
     }
+    v->type = JSON_ARRAY;
+    w->top = base;
     return parse_status;
 }
 
-/* value = null / false / true / number */
-static int nfjson_parse_value(nfjson_context *c, nfjson_value *val) {
-    switch (*(c->json)) {
-    case 'n': return nfjson_parse_literal(c, val, "null", JSON_NULL);
-    case 't': return nfjson_parse_literal(c, val, "true", JSON_TRUE);
-    case 'f': return nfjson_parse_literal(c, val, "false", JSON_FALSE);
-    case '0':case '1':case '2':case '3':case '4':case '5':case '6':
-    case '7':case '8':case '9':case '-':
-        return nfjson_parse_number(c, val);
-    case '"':return nfjson_parse_string(c, val);
-    case '[':return nfjson_parse_array(c, val);
-    case '{':return nfjson_parse_object(c, val);
-    case '\0': return NFJSON_PARSE_EXPECT_VALUE;
-    default:  return NFJSON_PARSE_INVALID_VALUE;
+/* n nodes of depth reach the value at c->json */
+static int nfjson_project_value(nfjson_project *w, nfjson_value *v, size_t depth, size_t n) {
+    const nfjson_projection_node **set = w->set + w->proj->level[depth];
+    size_t i;
+    for (i = 0; i < n; i++) if (set[i]->leaf) return nfjson_project_leaf(w, v, depth);
+    switch (PEEK(w->c)) {
+    case '{': return nfjson_project_object(w, v, depth, n);
+    case '[': return nfjson_project_array(w, v, depth, n);
+    default: return nfjson_project_skip(w->c);//a path going on below a scalar, v stays JSON_UNRESOLVED
     }
 }
 
-int nfjson_parse(nfjson_value *val, const char *json) {
-    assert(NULL != val);
-    nfjson_context context;
-    context.json = json;
-    context.stack = NULL;
-    context.size = 0;
-    context.top = 0;
+#ifndef NFJSON_PROJECT_SET_INLINE
+#define NFJSON_PROJECT_SET_INLINE 64
+#endif
+static int nfjson_parse_project(nfjson_context *c, nfjson_value *val, const nfjson_projection *proj) {
+    const nfjson_projection_node *inline_set[NFJSON_PROJECT_SET_INLINE];
+    size_t nodes = proj->level[proj->depth + 1];
+    nfjson_project w;
+    int parse_status;
+    w.c = c;
+    w.proj = proj;
+    w.set = nodes <= NFJSON_PROJECT_SET_INLINE ? inline_set :
+                                                            (const nfjson_projection_node **)malloc(sizeof(nfjson_projection_node *) * nodes);
+    w.set[0] = &proj->root;
+    w.max_depth = c->max_depth;
+    w.e = NULL;
+    w.size = w.top = 0;
+    w.m = NULL;
+    w.m_size = w.m_top = 0;
+    nfjson_dom_init(&w.dom, c, val);
     nfjson_init(val);
-    nfjson_parse_whitespace(&context);
-    int parse_status = nfjson_parse_value(&context, val);
-    if (parse_status == NFJSON_PARSE_OK){
-        nfjson_parse_whitespace(&context);
-        if(*(context.json)) parse_status = NFJSON_PARSE_ROOT_NOT_SINGULAR;
+    nfjson_parse_whitespace(c);
+    parse_status = nfjson_project_value(&w, val, 0, 1);
+    if (parse_status == NFJSON_PARSE_OK) {
+        nfjson_parse_whitespace(c);
+        if (c->json != c->end) parse_status = NFJSON_PARSE_ROOT_NOT_SINGULAR;
+    }
+    if (w.set != inline_set) free((void *)w.set);
+    free(w.e);
+    free(w.m);
+    nfjson_dom_free(&w.dom);
+    free(c->stack);
+    c->stack = NULL;
+    c->max_depth = w.max_depth;
+    return parse_status;
+}
+
+int nfjson_parse_projected(nfjson_value *val, const char *json, size_t len, const nfjson_projection *proj,
+                                                            const nfjson_parse_options *opts) {
+    assert(NULL != val && NULL != proj && (NULL != json || len == 0));
+    nfjson_context context;
+    int parse_status;
+    nfjson_context_init(&context, json, len, NULL);
+    nfjson_context_options(&context, opts);
+    if ((parse_status = nfjson_parse_project(&context, val, proj)) != NFJSON_PARSE_OK) {
+        nfjson_free(val);
+        nfjson_init(val);
     }
-    assert(context.top == 0);
-    free(context.stack);
     return parse_status;
 }
 
+int nfjson_parse_document_projected(nfjson_document *doc, const char *json, size_t len, const nfjson_projection *proj,
+                                                            const nfjson_parse_options *opts) {
+    assert(NULL != doc && NULL != proj && (NULL != json || len == 0));
+    nfjson_context context;
+    int parse_status;
+    nfjson_context_init(&context, json, len, &doc->arena);
+    nfjson_context_options(&context, opts);
+    nfjson_arena_init(&doc->arena);
+    if ((parse_status = nfjson_parse_project(&context, &doc->root, proj)) != NFJSON_PARSE_OK) {
+        nfjson_arena_free(&doc->arena);
+        nfjson_init(&doc->root);
+    }
+    return parse_status;
+}
+
+static void nfjson_parser_start(nfjson_parser *p, nfjson_value *val, nfjson_arena *arena, const nfjson_parse_options *opts) {
+    assert(NULL != p);
+    nfjson_context_init(&p->c, NULL, 0, arena);
+    nfjson_context_options(&p->c, opts);
+    nfjson_dom_init(&p->dom, &p->c, val);
+    if (val) nfjson_init(val);
+    nfjson_parse_start(&p->c, &nfjson_dom_handler, &p->dom);
+    p->doc = NULL;
+    p->carry = NULL;
+    p->carry_len = p->carry_size = 0;
+    p->carry_escape = 0;
+    p->status = NFJSON_PARSE_OK;
+}
+
+/* p must stay where it is until nfjson_parser_free */
+void nfjson_parser_init(nfjson_parser *p, nfjson_value *val, const nfjson_parse_options *opts) {
+    assert(NULL != val);
+    nfjson_parser_start(p, val, NULL, opts);
+}
+
+/* nodes go into doc->arena, strings are always copied since chunks do not outlive the call */
+void nfjson_parser_init_document(nfjson_parser *p, nfjson_document *doc, const nfjson_parse_options *opts) {
+    assert(NULL != doc);
+    nfjson_arena_init(&doc->arena);
+    nfjson_parser_start(p, &doc->root, &doc->arena, opts);
+    p->doc = doc;
+}
+
+/* events of the chunks go to handler, strings and keys are only valid during the callback */
+void nfjson_parser_init_sax(nfjson_parser *p, const nfjson_sax_handler *handler, void *ctx, const nfjson_parse_options *opts) {
+    assert(NULL != handler);
+    nfjson_parser_start(p, NULL, NULL, opts);
+    p->c.strings = NFJSON_STRING_BORROW;//the chunk outlives every callback
+    nfjson_parse_start(&p->c, handler, ctx);
+}
+
+static void nfjson_parser_carry(nfjson_parser *p, const char *s, size_t len) {
+    if (p->carry_len + len > p->carry_size) {
+        if (p->carry_size == 0) p->carry_size = NFJSON_PARSE_STACK_INIT_SIZE;
+        while (p->carry_len + len > p->carry_size) p->carry_size += p->carry_size >> 1;
+        p->carry = (char *)realloc(p->carry, p->carry_size);
+    }
+    memcpy(p->carry + p->carry_len, s, len);
+    p->carry_len += len;
+}
+
+/* run over c->json..c->end, only whitespace may follow the root */
+static int nfjson_parser_run(nfjson_parser *p, int run) {
+    nfjson_context *c = &p->c;
+    if (c->state != NFJSON_STATE_DONE) {
+        int parse_status = nfjson_parse_run(c, run);
+        if (parse_status == NFJSON_PARSE_NEED_MORE) return NFJSON_PARSE_OK;
+        if (parse_status != NFJSON_PARSE_OK) {
+            nfjson_dom_unwind(&p->dom);
+            return parse_status;
+        }
+    }
+    nfjson_parse_whitespace(c);
+    return c->json == c->end ? NFJSON_PARSE_OK : NFJSON_PARSE_ROOT_NOT_SINGULAR;
+}
+
+/**
+*   parse the next len bytes of the json, chunks may split it anywhere.
+*   nothing of chunk is referenced after the call, a token cut by the end
+*   of the chunk is carried over. returns the first error, or NFJSON_PARSE_OK
+*   while the json is fine so far
+**/
+int nfjson_parser_feed(nfjson_parser *p, const char *chunk, size_t len) {
+    nfjson_context *c = &p->c;
+    const char *end = chunk + len, *stop;
+    assert(NULL != p && (NULL != chunk || len == 0));
+    if (p->status != NFJSON_PARSE_OK) return p->status;
+    if (p->carry_len) {//complete the split token first and parse it on its own
+        stop = nfjson_token_scan(p->carry[0], &p->carry_escape, chunk, end);
+        nfjson_parser_carry(p, chunk, (stop ? stop : end) - chunk);
+        if (!stop) return NFJSON_PARSE_OK;
+        c->json = p->carry;
+        c->end = p->carry + p->carry_len;
+        p->carry_len = 0;
+        if ((p->status = nfjson_parser_run(p, NFJSON_RUN_TOKEN)) != NFJSON_PARSE_OK) return p->status;
+        chunk = stop;
+    }
+    c->json = chunk;
+    c->end = end;
+    p->status = nfjson_parser_run(p, NFJSON_RUN_MORE);
+    if (p->status == NFJSON_PARSE_OK && c->json != end) {
+        p->carry_escape = 0;
+        nfjson_token_scan(*c->json, &p->carry_escape, c->json + 1, end);
+        nfjson_parser_carry(p, c->json, end - c->json);
+    }
+    return p->status;
+}
+
+/* end of the json: the result of the whole parse, like nfjson_parse_n on the concatenated chunks */
+int nfjson_parser_finish(nfjson_parser *p) {
+    nfjson_context *c = &p->c;
+    assert(NULL != p);
+    if (p->status == NFJSON_PARSE_OK) {
+        c->json = p->carry;
+        c->end = p->carry + p->carry_len;
+        p->carry_len = 0;
+        p->status = nfjson_parser_run(p, NFJSON_RUN_LAST);
+    }
+    if (p->doc && p->dom.root->type == JSON_UNRESOLVED) nfjson_arena_free(&p->doc->arena);
+    return p->status;
+}
+
+/**
+*   ready for the next json with every buffer kept. the value of the last
+*   parse stays with the caller, a document is emptied into spare chunks
+**/
+void nfjson_parser_reset(nfjson_parser *p) {
+    assert(NULL != p);
+    nfjson_dom_unwind(&p->dom);
+    if (p->doc) nfjson_arena_reset(&p->doc->arena);
+    if (p->dom.root) nfjson_init(p->dom.root);
+    p->c.top = 0;
+    p->dom.top = 0;
+    p->carry_len = 0;
+    p->carry_escape = 0;
+    p->status = NFJSON_PARSE_OK;
+    nfjson_parse_start(&p->c, p->c.sax, p->c.sax_ctx);
+}
+
+/* a whole json on the warm buffers of p, the result like nfjson_parse_n */
+int nfjson_parser_parse(nfjson_parser *p, const char *json, size_t len) {
+    nfjson_context *c = &p->c;
+    assert(NULL != p && (NULL != json || len == 0));
+    nfjson_parser_reset(p);
+    if (c->stack == NULL) {//first use, the stack is kept from now on
+        c->size = NFJSON_PARSE_STACK_INIT_SIZE;
+        c->stack = (char *)malloc(c->size);
+    }
+    c->json = json;
+    c->end = json + len;
+    if ((p->status = nfjson_parse_events(c, 1)) != NFJSON_PARSE_OK) nfjson_dom_unwind(&p->dom);
+    if (p->doc && p->dom.root->type == JSON_UNRESOLVED) nfjson_arena_reset(&p->doc->arena);
+    return p->status;
+}
+
+/* releases the parser, and the partial value when it is dropped before finish */
+void nfjson_parser_free(nfjson_parser *p) {
+    assert(NULL != p);
+    nfjson_dom_unwind(&p->dom);
+    if (p->doc && p->dom.root->type == JSON_UNRESOLVED) nfjson_arena_free(&p->doc->arena);
+    nfjson_dom_free(&p->dom);
+    free(p->c.stack);
+    free(p->carry);
+    p->dom.stack = NULL;
+    p->dom.size = p->dom.top = 0;
+    p->c.stack = NULL;
+    p->c.size = p->c.top = 0;
+    p->carry = NULL;
+    p->carry_len = p->carry_size = 0;
+}
+
+/* the reader takes one event at a time and pauses the machine on it */
+static int nfjson_reader_token(void *ctx, nfjson_token_type type) {
+    nfjson_reader *r = (nfjson_reader *)ctx;
+    r->type = type;
+    r->depth = r->c.depth;
+    r->c.pause = 1;
+    return 1;
+}
+
+static int nfjson_reader_null(void *ctx) {
+    return nfjson_reader_token(ctx, NFJSON_TOKEN_NULL);
+}
+
+static int nfjson_reader_boolean(void *ctx, int b) {
+    return nfjson_reader_token(ctx, b ? NFJSON_TOKEN_TRUE : NFJSON_TOKEN_FALSE);
+}
+
+static int nfjson_reader_number(void *ctx, const nfjson_value *num) {
+    ((nfjson_reader *)ctx)->num = *num;
+    return nfjson_reader_token(ctx, NFJSON_TOKEN_NUMBER);
+}
+
+static int nfjson_reader_string(void *ctx, const char *s, size_t len) {
+    ((nfjson_reader *)ctx)->s = s;
+    ((nfjson_reader *)ctx)->len = len;
+    return nfjson_reader_token(ctx, NFJSON_TOKEN_STRING);
+}
+
+static int nfjson_reader_key(void *ctx, const char *s, size_t len) {
+    ((nfjson_reader *)ctx)->s = s;
+    ((nfjson_reader *)ctx)->len = len;
+    return nfjson_reader_token(ctx, NFJSON_TOKEN_KEY);
+}
+
+static int nfjson_reader_start_object(void *ctx) {
+    nfjson_reader_token(ctx, NFJSON_TOKEN_START_OBJECT);
+    ((nfjson_reader *)ctx)->depth--;//the frame is already open
+    return 1;
+}
+
+static int nfjson_reader_end_object(void *ctx, size_t members) {
+    (void)members;
+    return nfjson_reader_token(ctx, NFJSON_TOKEN_END_OBJECT);
+}
+
+static int nfjson_reader_start_array(void *ctx) {
+    nfjson_reader_token(ctx, NFJSON_TOKEN_START_ARRAY);
+    ((nfjson_reader *)ctx)->depth--;
+    return 1;
+}
+
+static int nfjson_reader_end_array(void *ctx, size_t elements) {
+    (void)elements;
+    return nfjson_reader_token(ctx, NFJSON_TOKEN_END_ARRAY);
+}
+
+static const nfjson_sax_handler nfjson_reader_handler = {
+    nfjson_reader_null, nfjson_reader_boolean, nfjson_reader_number, nfjson_reader_string, nfjson_reader_key,
+    nfjson_reader_start_object, nfjson_reader_end_object, nfjson_reader_start_array, nfjson_reader_end_array
+};
+
+void nfjson_reader_init(nfjson_reader *r, const char *json, size_t len, const nfjson_parse_options *opts) {
+    assert(NULL != r && (NULL != json || len == 0));
+    nfjson_context_init(&r->c, json, len, NULL);
+    nfjson_context_options(&r->c, opts);
+    r->c.strings = NFJSON_STRING_BORROW;//escape-free slices point into json
+    nfjson_parse_start(&r->c, &nfjson_reader_handler, r);
+    r->type = NFJSON_TOKEN_END;
+    r->s = NULL;
+    r->len = 0;
+    nfjson_init(&r->num);
+    r->depth = 0;
+    r->status = NFJSON_PARSE_OK;
+}
+
+/* move to the next token, an error sticks and leaves NFJSON_TOKEN_END */
+int nfjson_reader_next(nfjson_reader *r) {
+    nfjson_context *c = &r->c;
+    int parse_status;
+    assert(NULL != r);
+    r->type = NFJSON_TOKEN_END;
+    if (r->status != NFJSON_PARSE_OK) return r->status;
+    if (c->state != NFJSON_STATE_DONE) {
+        parse_status = nfjson_parse_run(c, NFJSON_RUN_LAST);
+        if (parse_status == NFJSON_PARSE_PAUSED) return NFJSON_PARSE_OK;
+        if (parse_status != NFJSON_PARSE_OK) return r->status = parse_status;
+        c->pause = 0;
+        if (r->type != NFJSON_TOKEN_END) return NFJSON_PARSE_OK;//the last token of the root
+    }
+    nfjson_parse_whitespace(c);
+    if (c->json != c->end) r->status = NFJSON_PARSE_ROOT_NOT_SINGULAR;
+    return r->status;
+}
+
+/**
+*   move past the next value, the key included if it is a member. a whole
+*   array or object is checked but nothing of it is kept, the current token
+*   is its end then. at the end of a container this reads the end token
+**/
+int nfjson_reader_skip(nfjson_reader *r) {
+    size_t depth;
+    int parse_status = nfjson_reader_next(r);
+    if (parse_status == NFJSON_PARSE_OK && r->type == NFJSON_TOKEN_KEY) parse_status = nfjson_reader_next(r);
+    if (parse_status != NFJSON_PARSE_OK || (r->type != NFJSON_TOKEN_START_OBJECT && r->type != NFJSON_TOKEN_START_ARRAY))
+        return parse_status;
+    depth = r->depth;
+    while ((parse_status = nfjson_reader_next(r)) == NFJSON_PARSE_OK && r->depth != depth);
+    return parse_status;
+}
+
+void nfjson_reader_free(nfjson_reader *r) {
+    assert(NULL != r);
+    free(r->c.stack);
+    r->c.stack = NULL;
+    r->c.size = r->c.top = 0;
+}
+
 #define PUSHS(c,str,len) do { memcpy(nfjson_context_push(c, len), str, len); }while(0)
+
+static const char nfjson_digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* shortest decimal form, two digits per step from the back of buf */
+static void nfjson_stringify_integer(nfjson_context *c, uint64_t u, int negative) {
+    char buf[21], *p = buf + sizeof(buf);
+    while (u >= 100) {
+        p -= 2;
+        memcpy(p, nfjson_digit_pairs + (u % 100) * 2, 2);
+        u /= 100;
+    }
+    if (u >= 10) {
+        p -= 2;
+        memcpy(p, nfjson_digit_pairs + u * 2, 2);
+    }
+    else *--p = (char)('0' + u);
+    if (negative) *--p = '-';
+    PUSHS(c, p, buf + sizeof(buf) - p);
+}
+
+static void nfjson_stringify_number(nfjson_context *c, nfjson_value *val) {
+    switch (val->ntype) {
+    case NFJSON_NUMBER_INT64:
+        if (val->u.i < 0) nfjson_stringify_integer(c, 0 - (uint64_t)val->u.i, 1);
+        else nfjson_stringify_integer(c, (uint64_t)val->u.i, 0);
+        break;
+    case NFJSON_NUMBER_UINT64: nfjson_stringify_integer(c, val->u.ui, 0); break;
+    default: c->top -= 32 - sprintf((char *)nfjson_context_push(c, 32), "%.17g", val->u.n);//precison doubut
+    }
+}
 static nfjson_stringify_string(nfjson_context *c, nfjson_string *str) {
     PUSHC(c, '"');
     //memcpy(nfjson_context_push(c, val->u.s.len), val->u.s.s, val->u.s.len);//'\0' -> "\u0000"
-    char *s = str->s;
-    size_t i = 0, len = str->len;
-    for (; i < len; i++)
-        if (s[i]) {
-            switch (s[i]) {
+    const char *s = str->s, *end = str->s + str->len, *run;
+    while (s < end) {
+        run = nfjson_scan_string(s, end, 0);
+        if (run != s) {
+            PUSHS(c, s, run - s);
+            if ((s = run) == end) break;
+        }
+        if (*s) {
+            switch (*s) {
             case '\"': PUSHS(c, "\\\"", 2); break;
             case '\\': PUSHS(c, "\\\\", 2); break;
             case '\b': PUSHS(c, "\\b", 2); break;
@@ -466,12 +1677,12 @@ static nfjson_stringify_string(nfjson_context *c, nfjson_string *str) {
             case '\r': PUSHS(c, "\\r", 2); break;
             case '\t': PUSHS(c, "\\t", 2); break;
             //case '\/': PUSHC(c, '\"'); break;
-            default:
-                if (s[i] < 0x20) sprintf((char *)nfjson_context_push(c, 6), "\\u00%02X", s[i]);
-                else PUSHC(c, s[i]);
+            default: sprintf((char *)nfjson_context_push(c, 6), "\\u00%02X", *s);//control char
             }
         }
         else memcpy(nfjson_context_push(c, 6), "\\u0000", 6);
+        s++;
+    }
     PUSHC(c, '"');
 }
 
@@ -480,7 +1691,7 @@ static int nfjson_stringify_value(nfjson_context *c, nfjson_value *val) {
     case JSON_NULL: PUSHS(c, "null", 4); break;
     case JSON_FALSE: PUSHS(c, "false", 5); break;
     case JSON_TRUE: PUSHS(c, "true", 4); break;
-    case JSON_NUMBER: c->top -= 32 - sprintf((char *)nfjson_context_push(c, 32), "%.17g", val->u.n); break;//precison doubut
+    case JSON_NUMBER: nfjson_stringify_number(c, val); break;
     case JSON_STRING: nfjson_stringify_string(c, &(val->u.s)); break;
     case JSON_ARRAY: 
     {
@@ -498,26 +1709,19 @@ static int nfjson_stringify_value(nfjson_context *c, nfjson_value *val) {
     case JSON_OBJECT: 
     {
         PUSHC(c, '{');
-        size_t size = (size_t)val->u.ht->cnt, i = 0, cnt = 0;
-        kv **table = val->u.ht->table;
-        kv* kv_list = NULL;
-        while (cnt < size) {
-            if (kv_list = table[i]) {
-                while (kv_list) {
-                    nfjson_stringify_string(c, (nfjson_string *)kv_list->key);
-                    PUSHC(c, ':');
-                    nfjson_stringify_value(c, (nfjson_value *)kv_list->val);
-                    kv_list = kv_list->next;
-                    PUSHC(c, ',');
-                    cnt++;
-                }
-            }
-            i++;
+        size_t size = val->u.o ? val->u.o->len : 0, i = 0;
+        nfjson_member *m = size ? val->u.o->m : NULL;
+        for (; i < size; i++) {//in input order
+            nfjson_stringify_string(c, &m[i].key);
+            PUSHC(c, ':');
+            nfjson_stringify_value(c, &m[i].val);
+            PUSHC(c, ',');
         }
         if(size) c->top--;//pop the last ','
         PUSHC(c, '}');
     }
     break;
+    case JSON_LAZY: return nfjson_stringify_value(c, nfjson_lazy_resolve(val));
     case JSON_UNRESOLVED: return NFJSON_STRINGIFY_UNRESOLVED_TYPE;
     default:return NFJSON_STRINGIFY_INVALID_TYPE;
     }
@@ -525,20 +1729,34 @@ static int nfjson_stringify_value(nfjson_context *c, nfjson_value *val) {
 }
 
 char *nfjson_stringify(nfjson_value *val, size_t *_len, int *_status) {
-    nfjson_context *c = malloc(sizeof(nfjson_context));
-    memset(c, 0, sizeof(nfjson_context));
+    nfjson_context c;
+    memset(&c, 0, sizeof(nfjson_context));
     char *json = NULL;
     int status;
+    if ((status = nfjson_stringify_value(&c, val)) == NFJSON_STRINGIFY_OK) {
+        if (_len) *_len = c.top;
+        PUSHC(&c, '\0');
+        json = (char *)realloc(c.stack, c.top);//the stack is the text, trimmed
+        c.stack = NULL;
+    }
+    if (_status) *_status = status;
+    free(c.stack);
+    return json;
+}
+
+/* the text lives in p until its next call, a warm p allocates nothing */
+const char *nfjson_parser_stringify(nfjson_parser *p, nfjson_value *val, size_t *_len, int *_status) {
+    nfjson_context *c = &p->c;
+    size_t start = c->top;
+    const char *json = NULL;
+    int status;
+    assert(NULL != p && NULL != val);
     if ((status = nfjson_stringify_value(c, val)) == NFJSON_STRINGIFY_OK) {
-        size_t len = c->top;
-        if (_len) *_len = len;
-        json = malloc(sizeof(char)*(len + 1));
-        memcpy(json, nfjson_context_pop(c, len), len);
-        json[len] = 0;
+        if (_len) *_len = c->top - start;
+        PUSHC(c, '\0');
+        json = c->stack + start;
     }
     if (_status) *_status = status;
-    assert(c->top == 0);
-    free(c->stack);
-    free(c);
+    c->top = start;//the text stays above the parse state
     return json;
 }
\ No newline at end of file
@@ -1,6 +1,129 @@
 #include"pch.h"
 #include"notfastjson.h"
 
+/**
+*   nfjson_parse_n reads exactly [json, json + len), the json needs no '\0'
+*   and any '\0' inside it is parsed as an ordinary byte.
+*   nfjson_parse_padded additionally requires NFJSON_PADDING readable bytes
+*   after json + len (any content), block kernels may load across the end
+*   instead of falling back to byte loops on the tail.
+**/
+#ifndef NFJSON_PADDING
+#define NFJSON_PADDING 64
+#endif
+
 int nfjson_parse(nfjson_value *val, const char *json);
 
+int nfjson_parse_n(nfjson_value *val, const char *json, size_t len);
+
+/**
+*   nesting is parsed without recursion and limited by opts->max_depth,
+*   deeper json fails with NFJSON_PARSE_TOO_DEEP. nfjson_free and
+*   nfjson_stringify still recurse, keep the limit sane for those.
+**/
+#ifndef NFJSON_PARSE_MAX_DEPTH
+#define NFJSON_PARSE_MAX_DEPTH 1024
+#endif
+
+int nfjson_parse_opts(nfjson_value *val, const char *json, size_t len, const nfjson_parse_options *opts);
+
+int nfjson_parse_padded(nfjson_value *val, const char *json, size_t len);
+
+/**
+*   the file is memory-mapped and parsed in place with NFJSON_PADDING where
+*   the mapping allows it, the text is never copied to the heap. strings are
+*   copied out, nothing refers to the file after the call
+**/
+int nfjson_parse_file(nfjson_value *val, const char *path, const nfjson_parse_options *opts);
+
+int nfjson_parse_document_file(nfjson_document *doc, const char *path, const nfjson_parse_options *opts);
+
+/**
+*   event parsing without a DOM, see nfjson_sax_handler. memory stays
+*   bounded by the nesting depth whatever the size of the json
+**/
+int nfjson_parse_sax(const nfjson_sax_handler *handler, void *ctx, const char *json, size_t len,
+                                                            const nfjson_parse_options *opts);
+
+int nfjson_parse_document(nfjson_document *doc, const char *json);
+
+int nfjson_parse_document_n(nfjson_document *doc, const char *json, size_t len);
+
+int nfjson_parse_document_opts(nfjson_document *doc, const char *json, size_t len, const nfjson_parse_options *opts);
+
+/**
+*   strings and keys without escapes point into json, which must outlive
+*   doc. that text is not '\0' terminated, only nfjson_get_string_length
+*   and nfjson_string.len bound it. escaped ones are copied and terminated
+**/
+int nfjson_parse_document_borrowed(nfjson_document *doc, const char *json, size_t len);
+
+int nfjson_parse_document_insitu(nfjson_document *doc, char *json, size_t len);
+
+/**
+*   the json is validated once and only the root is decoded, any other
+*   value when an accessor first returns it. json must outlive doc and doc
+*   must stay where it is. decoded strings and keys are copied into doc and
+*   '\0' terminated
+**/
+int nfjson_parse_document_lazy(nfjson_document *doc, const char *json, size_t len);
+
+nfjson_value *nfjson_lazy_resolve(nfjson_value *val);
+
+/**
+*   only the values on the paths of proj are built, see projection.h.
+*   everything else is skipped by string ends and bracket balance without
+*   being decoded or fully checked. objects keep the members on a path,
+*   arrays keep every position and leave those off the paths
+*   JSON_UNRESOLVED. a path going on below a scalar takes nothing
+**/
+int nfjson_parse_projected(nfjson_value *val, const char *json, size_t len, const nfjson_projection *proj,
+                                                            const nfjson_parse_options *opts);
+
+int nfjson_parse_document_projected(nfjson_document *doc, const char *json, size_t len, const nfjson_projection *proj,
+                                                            const nfjson_parse_options *opts);
+
+int nfjson_parse_elements(const char *json, size_t len, const nfjson_parse_options *opts, nfjson_value **e, size_t *count);
+
+/**
+*   push parsing: init, feed the json in chunks of any size, finish, free.
+*   the parser keeps its own state and copies of split tokens between calls.
+**/
+void nfjson_parser_init(nfjson_parser *p, nfjson_value *val, const nfjson_parse_options *opts);
+
+void nfjson_parser_init_document(nfjson_parser *p, nfjson_document *doc, const nfjson_parse_options *opts);
+
+void nfjson_parser_init_sax(nfjson_parser *p, const nfjson_sax_handler *handler, void *ctx, const nfjson_parse_options *opts);
+
+int nfjson_parser_feed(nfjson_parser *p, const char *chunk, size_t len);
+
+int nfjson_parser_finish(nfjson_parser *p);
+
+void nfjson_parser_free(nfjson_parser *p);
+
+/**
+*   a parser used again and again keeps its stacks, and the arena chunks of
+*   its document, so parsing and stringifying small json stops allocating
+*   once the buffers have grown to fit
+**/
+void nfjson_parser_reset(nfjson_parser *p);
+
+int nfjson_parser_parse(nfjson_parser *p, const char *json, size_t len);
+
+const char *nfjson_parser_stringify(nfjson_parser *p, nfjson_value *val, size_t *_len, int *status);
+
+/**
+*   pull parsing: every nfjson_reader_next moves r to the next token of the
+*   json and returns NFJSON_PARSE_OK, NFJSON_TOKEN_END follows the root.
+*   slices and numbers stay valid until the next call, nothing is allocated
+*   per token. json must outlive r
+**/
+void nfjson_reader_init(nfjson_reader *r, const char *json, size_t len, const nfjson_parse_options *opts);
+
+int nfjson_reader_next(nfjson_reader *r);
+
+int nfjson_reader_skip(nfjson_reader *r);
+
+void nfjson_reader_free(nfjson_reader *r);
+
 char * nfjson_stringify(nfjson_value * val, size_t * _len, int * status);
@@ -0,0 +1,119 @@
+#include"pch.h"
+#include"projection.h"
+
+/* "0" or a digit run without leading zeros, as RFC 6901 spells array indexes */
+static size_t nfjson_projection_token_index(const char *s, size_t len) {
+    size_t i, index = 0;
+    if (len == 0 || (s[0] == '0' && len > 1)) return NFJSON_PROJECTION_NO_INDEX;
+    for (i = 0; i < len; i++) {
+        if (s[i] < '0' || s[i] > '9' || index > (NFJSON_PROJECTION_NO_INDEX - 1 - (s[i] - '0')) / 10) return NFJSON_PROJECTION_NO_INDEX;
+        index = index * 10 + (s[i] - '0');
+    }
+    return index;
+}
+
+static nfjson_projection_node *nfjson_projection_child(nfjson_projection_node *node, const char *name, size_t len) {
+    nfjson_projection_node *child;
+    size_t i;
+    for (i = 0; i < node->count; i++) {
+        child = node->child + i;
+        if (child->len == len && memcmp(child->name, name, len) == 0) return child;
+    }
+    node->child = (nfjson_projection_node *)realloc(node->child, sizeof(nfjson_projection_node) * (node->count + 1));
+    child = node->child + node->count++;
+    memset(child, 0, sizeof(nfjson_projection_node));
+    child->name = (char *)malloc(len + 1);
+    if (len) memcpy(child->name, name, len);
+    child->name[len] = 0;
+    child->len = len;
+    child->index = nfjson_projection_token_index(name, len);
+    child->wildcard = len == 1 && name[0] == '*';
+    return child;
+}
+
+/* path = *( "/" reference-token ), '~' only in "~0" for '~' and "~1" for '/' */
+static int nfjson_projection_add(nfjson_projection *proj, const char *path) {
+    nfjson_projection_node *node = &proj->root;
+    char *token = (char *)malloc(strlen(path) + 1);
+    size_t len, depth = 0;
+    while (*path) {
+        if (*path++ != '/') { free(token); return -1; }
+        for (len = 0; *path && *path != '/'; path++) {
+            if (*path == '~') {
+                if (path[1] != '0' && path[1] != '1') { free(token); return -1; }
+                token[len++] = *++path == '0' ? '~' : '/';
+            }
+            else token[len++] = *path;
+        }
+        node = nfjson_projection_child(node, token, len);
+        if (++depth > proj->depth) proj->depth = depth;
+    }
+    node->leaf = 1;
+    free(token);
+    return 0;
+}
+
+static void nfjson_projection_count(const nfjson_projection_node *node, size_t depth, size_t *width) {
+    size_t i;
+    width[depth]++;
+    for (i = 0; i < node->count; i++) nfjson_projection_count(node->child + i, depth + 1, width);
+}
+
+static void nfjson_projection_node_free(nfjson_projection_node *node) {
+    size_t i;
+    for (i = 0; i < node->count; i++) nfjson_projection_node_free(node->child + i);
+    free(node->child);
+    free(node->name);
+}
+
+nfjson_projection *nfjson_projection_new(const char *const *paths, size_t count) {
+    nfjson_projection *proj = (nfjson_projection *)malloc(sizeof(nfjson_projection));
+    size_t i;
+    assert(NULL != paths || count == 0);
+    memset(proj, 0, sizeof(nfjson_projection));
+    proj->root.index = NFJSON_PROJECTION_NO_INDEX;
+    for (i = 0; i < count; i++) {
+        if (nfjson_projection_add(proj, paths[i]) != 0) {
+            nfjson_projection_free(proj);
+            return NULL;
+        }
+    }
+    //a walk needs room for as many nodes as one depth has, each depth gets its own slice
+    proj->level = (size_t *)calloc(proj->depth + 2, sizeof(size_t));
+    nfjson_projection_count(&proj->root, 1, proj->level);
+    for (i = 1; i < proj->depth + 2; i++) proj->level[i] += proj->level[i - 1];
+    return proj;
+}
+
+void nfjson_projection_free(nfjson_projection *proj) {
+    if (proj == NULL) return;
+    nfjson_projection_node_free(&proj->root);
+    free(proj->level);
+    free(proj);
+}
+
+size_t nfjson_projection_member(const nfjson_projection_node *const *set, size_t n, const char *key, size_t len,
+                                                            const nfjson_projection_node **out) {
+    const nfjson_projection_node *child;
+    size_t i, j, m = 0;
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < set[i]->count; j++) {
+            child = set[i]->child + j;
+            if (child->wildcard || (child->len == len && (len == 0 || memcmp(child->name, key, len) == 0))) out[m++] = child;
+        }
+    }
+    return m;
+}
+
+size_t nfjson_projection_element(const nfjson_projection_node *const *set, size_t n, size_t index,
+                                                            const nfjson_projection_node **out) {
+    const nfjson_projection_node *child;
+    size_t i, j, m = 0;
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < set[i]->count; j++) {
+            child = set[i]->child + j;
+            if (child->wildcard || child->index == index) out[m++] = child;
+        }
+    }
+    return m;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include"pch.h"
+#include"notfastjson.h"
+
+/**
+*   JSON Pointer paths (RFC 6901) merged into a trie, see
+*   nfjson_parse_projected. a "*" token takes every member or element, a
+*   node ending some path takes its whole subtree
+**/
+typedef struct nfjson_projection_node nfjson_projection_node;
+
+struct nfjson_projection_node {
+    char *name;/*the reference token, unescaped*/
+    size_t len;
+    size_t index;/*array element the token names, NFJSON_PROJECTION_NO_INDEX if none*/
+    int wildcard;/*"*"*/
+    int leaf;/*a path ends here*/
+    nfjson_projection_node *child;
+    size_t count;/*children*/
+};
+
+#define NFJSON_PROJECTION_NO_INDEX ((size_t)-1)
+
+struct nfjson_projection {
+    nfjson_projection_node root;
+    size_t depth;/*of the deepest node*/
+    size_t *level;/*level[d]: nodes above depth d, where a walk keeps its node set of depth d*/
+};
+
+/* NULL when a path is not a JSON Pointer, "" is the whole json */
+nfjson_projection *nfjson_projection_new(const char *const *paths, size_t count);
+
+void nfjson_projection_free(nfjson_projection *proj);
+
+/* children of the n nodes in set taking the member named key, into out, returns how many */
+size_t nfjson_projection_member(const nfjson_projection_node *const *set, size_t n, const char *key, size_t len,
+                                                            const nfjson_projection_node **out);
+
+size_t nfjson_projection_element(const nfjson_projection_node *const *set, size_t n, size_t index,
+                                                            const nfjson_projection_node **out);
@@ -0,0 +1,64 @@
+#pragma once
+#include"pch.h"
+#include<stdint.h>
+
+/* instruction sets picked at compile time, every kernel keeps a scalar path */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NFJSON_SSE2
+#include<emmintrin.h>
+#endif
+#if defined(__SSSE3__) || defined(__AVX__)
+#define NFJSON_SSSE3
+#include<tmmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define NFJSON_AVX2
+#include<immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include<intrin.h>
+#endif
+
+/* index of the lowest set bit, x != 0 */
+static __inline int nfjson_ctz64(uint64_t x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return (int)i;
+#elif defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    int i = 0;
+    while (!(x & 1)) { x >>= 1; i++; }
+    return i;
+#endif
+}
+
+static __inline int nfjson_ctz32(unsigned int x) {
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward(&i, x);
+    return (int)i;
+#elif defined(__GNUC__)
+    return __builtin_ctz(x);
+#else
+    int i = 0;
+    while (!(x & 1)) { x >>= 1; i++; }
+    return i;
+#endif
+}
+
+/* number of leading zero bits, x != 0 */
+static __inline int nfjson_clz64(uint64_t x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long i;
+    _BitScanReverse64(&i, x);
+    return 63 - (int)i;
+#elif defined(__GNUC__)
+    return __builtin_clzll(x);
+#else
+    int i = 0;
+    while (!(x & 0x8000000000000000ULL)) { x <<= 1; i++; }
+    return i;
+#endif
+}
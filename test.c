@@ -4,6 +4,11 @@
 #include"access.h"
 #include"memory.h"
 #include"hash_table.h"
+#include"ndjson.h"
+#include"parallel.h"
+#include"projection.h"
+#include"object.h"
+#include"utf8.h"
 
 static int main_ret = 0;
 static int test_count = 0;
@@ -22,6 +27,7 @@ static int test_pass = 0;
 
 #define EXPECT_EQ_INT(expect, actual) EXPECT_EQ_BASE((expect) == (actual), expect, actual, "%d")
 #define EXPECT_EQ_DOUBLE(expect, actual) EXPECT_EQ_BASE(fabs((double)(expect) - (double)(actual))<1e6, (double)(expect), (double)(actual), "%f")
+#define EXPECT_EQ_NUMBER(expect, actual) EXPECT_EQ_BASE((double)(expect) == (double)(actual), (double)(expect), (double)(actual), "%.17g")
 #define EXPECT_NOT_EQ_INT(expect, actual) EXPECT_EQ_BASE((expect) != (actual), expect, actual, "%d")
 
 #define TEST(expect, json, json_type) \
@@ -82,6 +88,7 @@ static void test_parse_expect_value() {
     //test in array
     TEST_ERROR(NFJSON_PARSE_EXPECT_VALUE, "[,");
     TEST_ERROR(NFJSON_PARSE_EXPECT_VALUE, "[,]");
+    TEST_ERROR(NFJSON_PARSE_EXPECT_VALUE, "[,1]");
     TEST_ERROR(NFJSON_PARSE_EXPECT_VALUE, "[1.0,\"5\", [[,]] ,]");
 }
 
@@ -136,9 +143,81 @@ static void test_parse_number() {
     TEST_NUMBER(-1.7976931348623157e+308, "-1.7976931348623157e+308");
 }
 
+#define TEST_NUMBER_EXACT(expect, json) \
+                do{\
+                    nfjson_value __v;\
+                    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse(&__v, json));\
+                    EXPECT_EQ_INT(JSON_NUMBER, nfjson_get_type(&__v));\
+                    EXPECT_EQ_BASE((expect) == nfjson_get_number(&__v), (double)(expect), nfjson_get_number(&__v), "%.17g");\
+                    nfjson_free(&__v);\
+                }while(0)
+
+static void test_parse_number_exact() {
+    TEST_NUMBER_EXACT(0.1, "0.1");
+    TEST_NUMBER_EXACT(1e23, "1e23");
+    TEST_NUMBER_EXACT(9007199254740992.0, "9007199254740993");/* halfway, to even */
+    TEST_NUMBER_EXACT(12345678.87654321, "12345678.87654321");
+    TEST_NUMBER_EXACT(7.2057594037927933e16, "7.2057594037927933e16");
+    TEST_NUMBER_EXACT(2.2250738585072011e-308, "2.2250738585072011e-308");
+    TEST_NUMBER_EXACT(4.9406564584124654e-324, "2.4703282292062328e-324");
+    TEST_NUMBER_EXACT(0.0, "2.4703282292062327e-324");
+    TEST_NUMBER_EXACT(1.2345678901234567e29, "123456789012345678901234567890");
+    TEST_NUMBER_EXACT(1.0, "1.00000000000000000000000000000000000000000000000000000001");
+    TEST_NUMBER_EXACT(1e-5, "0.0000100000000000000000000000000000000000000000000000000000");
+    TEST_NUMBER_EXACT(1.7976931348623157e308, "1.7976931348623158e308");
+    TEST_NUMBER_EXACT(0.0, "0e999999999999999999999");
+    TEST_NUMBER_EXACT(-1.5, "-15e-1");
+    {
+        nfjson_value v;
+        EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse(&v, "[0.5,1e2,-0,12345678901234567890123]"));
+        EXPECT_EQ_BASE(0.5 == nfjson_get_number(nfjson_get_array_element(&v, 0)), 0.5, nfjson_get_number(nfjson_get_array_element(&v, 0)), "%.17g");
+        EXPECT_EQ_BASE(100.0 == nfjson_get_number(nfjson_get_array_element(&v, 1)), 100.0, nfjson_get_number(nfjson_get_array_element(&v, 1)), "%.17g");
+        EXPECT_EQ_BASE(1.2345678901234568e22 == nfjson_get_number(nfjson_get_array_element(&v, 3)), 1.2345678901234568e22,
+                                                nfjson_get_number(nfjson_get_array_element(&v, 3)), "%.17g");
+        nfjson_free(&v);
+    }
+}
+
+#define TEST_INTEGER(ntype, expect, json, get) \
+                do{\
+                    nfjson_value __v;\
+                    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse(&__v, json));\
+                    EXPECT_EQ_INT(JSON_NUMBER, nfjson_get_type(&__v));\
+                    EXPECT_EQ_INT(ntype, nfjson_get_number_type(&__v));\
+                    EXPECT_EQ_BASE((expect) == get(&__v), (long long)(expect), (long long)get(&__v), "%lld");\
+                    nfjson_free(&__v);\
+                }while(0)
+
+static void test_parse_integer() {
+    TEST_INTEGER(NFJSON_NUMBER_INT64, 0, "0", nfjson_get_int64);
+    TEST_INTEGER(NFJSON_NUMBER_INT64, -1, "-1", nfjson_get_int64);
+    TEST_INTEGER(NFJSON_NUMBER_INT64, 9007199254740993LL, "9007199254740993", nfjson_get_int64);
+    TEST_INTEGER(NFJSON_NUMBER_INT64, INT64_MAX, "9223372036854775807", nfjson_get_int64);
+    TEST_INTEGER(NFJSON_NUMBER_INT64, INT64_MIN, "-9223372036854775808", nfjson_get_int64);
+    TEST_INTEGER(NFJSON_NUMBER_UINT64, 9223372036854775808ULL, "9223372036854775808", nfjson_get_uint64);
+    TEST_INTEGER(NFJSON_NUMBER_UINT64, UINT64_MAX, "18446744073709551615", nfjson_get_uint64);
+    /* fraction, exponent, -0 and out of range stay double */
+    TEST_INTEGER(NFJSON_NUMBER_DOUBLE, 1, "1.0", nfjson_get_int64);
+    TEST_INTEGER(NFJSON_NUMBER_DOUBLE, 100, "1e2", nfjson_get_int64);
+    TEST_INTEGER(NFJSON_NUMBER_DOUBLE, 0, "-0", nfjson_get_int64);
+    /* read as the other type, out of range saturates */
+    TEST_INTEGER(NFJSON_NUMBER_DOUBLE, INT64_MAX, "1e300", nfjson_get_int64);
+    TEST_INTEGER(NFJSON_NUMBER_DOUBLE, INT64_MIN, "-1e300", nfjson_get_int64);
+    TEST_INTEGER(NFJSON_NUMBER_DOUBLE, -2, "-2.5", nfjson_get_int64);
+    TEST_INTEGER(NFJSON_NUMBER_DOUBLE, UINT64_MAX, "1e300", nfjson_get_uint64);
+    TEST_INTEGER(NFJSON_NUMBER_DOUBLE, 0, "-1e300", nfjson_get_uint64);
+    TEST_INTEGER(NFJSON_NUMBER_UINT64, INT64_MAX, "18446744073709551615", nfjson_get_int64);
+    TEST_INTEGER(NFJSON_NUMBER_INT64, 0, "-1", nfjson_get_uint64);
+    TEST_NUMBER_EXACT(18446744073709551616.0, "18446744073709551616");
+    TEST_NUMBER_EXACT(-9223372036854775809.0, "-9223372036854775809");
+    TEST_NUMBER_EXACT(99999999999999999999.0, "99999999999999999999");
+}
+
 static void test_parse_number_too_big() {
     TEST_ERROR(NFJSON_PARSE_NUMBER_TOO_BIG, "1e309");
     TEST_ERROR(NFJSON_PARSE_NUMBER_TOO_BIG, "-1e309");
+    TEST_ERROR(NFJSON_PARSE_NUMBER_TOO_BIG, "1.7976931348623159e308");
+    TEST_ERROR(NFJSON_PARSE_NUMBER_TOO_BIG, "[1e99999999999999999999]");
 }
 
 #define EXPECT_EQ_STRING(s1, s2, len) \
@@ -224,6 +303,16 @@ static void test_access_number() {
     EXPECT_EQ_DOUBLE((double)0, nfjson_get_number(&val));
     nfjson_set_number(&val, 1E5);
     EXPECT_EQ_DOUBLE(1e5, nfjson_get_number(&val));
+    nfjson_set_int64(&val, -42);
+    EXPECT_EQ_INT(NFJSON_NUMBER_INT64, nfjson_get_number_type(&val));
+    EXPECT_TRUE(-42 == nfjson_get_int64(&val));
+    EXPECT_EQ_NUMBER(-42.0, nfjson_get_number(&val));
+    nfjson_set_uint64(&val, UINT64_MAX);
+    EXPECT_EQ_INT(NFJSON_NUMBER_UINT64, nfjson_get_number_type(&val));
+    EXPECT_TRUE(UINT64_MAX == nfjson_get_uint64(&val));
+    nfjson_set_number(&val, 7.9);
+    EXPECT_EQ_INT(NFJSON_NUMBER_DOUBLE, nfjson_get_number_type(&val));
+    EXPECT_TRUE(7 == nfjson_get_int64(&val));
     nfjson_free(&val);
 }
 
@@ -249,10 +338,102 @@ static void test_parse_invalid_unicode_surrogate() {
     TEST_ERROR(NFJSON_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\\\\"");
     TEST_ERROR(NFJSON_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\uDBFF\"");
     TEST_ERROR(NFJSON_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\uE000\"");
+    TEST_ERROR(NFJSON_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uDC00\"");
+    TEST_ERROR(NFJSON_PARSE_INVALID_UNICODE_SURROGATE, "\"a\\uDFFF\\uD800\"");
 }
 
 #define EXPECT_EQ_SIZE_T(expect, actual) EXPECT_EQ_BASE((size_t)(expect)== (size_t)(actual), (size_t)(expect), (size_t)(actual), "%zu")
 
+static void test_parse_string_runs() {
+    /* escapes, control chars and the closing quote at every offset of the block kernels */
+    char json[80], expect[80];
+    size_t i;
+    nfjson_value v;
+    for (i = 0; i < 70; i++) {
+        memset(json, 'a', sizeof(json));
+        memset(expect, 'a', sizeof(expect));
+        json[0] = '"';
+        json[i + 1] = '\\';
+        json[i + 2] = 'n';
+        json[i + 3] = '\xC3';
+        json[i + 4] = '\xA9';
+        json[i + 5] = '"';
+        expect[i] = '\n';
+        expect[i + 1] = '\xC3';
+        expect[i + 2] = '\xA9';
+        EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_n(&v, json, i + 6));
+        EXPECT_EQ_SIZE_T(i + 3, nfjson_get_string_length(&v));
+        EXPECT_TRUE(memcmp(expect, nfjson_get_string(&v), i + 3) == 0);
+        nfjson_free(&v);
+        json[i + 5] = '\x1F';
+        EXPECT_EQ_INT(NFJSON_PARSE_INVALID_STRING_CHAR, nfjson_parse_n(&v, json, i + 6));
+        EXPECT_EQ_INT(NFJSON_PARSE_MISS_QUOTATION_MARK, nfjson_parse_n(&v, json, i + 5));
+    }
+}
+
+static void test_parse_invalid_utf8() {
+    char json[80];
+    size_t i;
+    nfjson_value v;
+    nfjson_parse_options trusted = { 0, 1 };
+    TEST_STRING("\xC2\xA2\xE2\x82\xAC\xF0\x9D\x84\x9E\xF4\x8F\xBF\xBF", "\"\xC2\xA2\xE2\x82\xAC\xF0\x9D\x84\x9E\xF4\x8F\xBF\xBF\"");
+    TEST_ERROR(NFJSON_PARSE_INVALID_UTF8, "\"\x80\"");              /* stray continuation */
+    TEST_ERROR(NFJSON_PARSE_INVALID_UTF8, "\"\xC2\"");              /* cut short by the quote */
+    TEST_ERROR(NFJSON_PARSE_INVALID_UTF8, "\"\xE2\x82\\n\"");       /* cut short by an escape */
+    TEST_ERROR(NFJSON_PARSE_INVALID_UTF8, "\"\xC0\xAF\"");          /* overlong '/' */
+    TEST_ERROR(NFJSON_PARSE_INVALID_UTF8, "\"\xE0\x80\xAF\"");
+    TEST_ERROR(NFJSON_PARSE_INVALID_UTF8, "\"\xF0\x80\x80\xAF\"");
+    TEST_ERROR(NFJSON_PARSE_INVALID_UTF8, "\"\xED\xA0\x80\"");      /* surrogate U+D800 */
+    TEST_ERROR(NFJSON_PARSE_INVALID_UTF8, "\"\xF4\x90\x80\x80\"");  /* U+110000 */
+    TEST_ERROR(NFJSON_PARSE_INVALID_UTF8, "\"\xFF\"");
+    TEST_ERROR(NFJSON_PARSE_MISS_KEY, "{\"\xC3\x28\":1}");               /* as any bad key */
+    /* the bad byte at every offset of the block kernels */
+    for (i = 0; i < 70; i++) {
+        memset(json, 'a', sizeof(json));
+        json[0] = '"';
+        json[i + 1] = '\xE2';
+        json[i + 2] = '\x82';
+        json[i + 3] = '\xAC';
+        json[75] = '"';
+        EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_n(&v, json, 76));
+        nfjson_free(&v);
+        json[i + 3] = 'a';
+        EXPECT_EQ_INT(NFJSON_PARSE_INVALID_UTF8, nfjson_parse_n(&v, json, 76));
+        EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_opts(&v, json, 76, &trusted));
+        EXPECT_EQ_SIZE_T(74, nfjson_get_string_length(&v));
+        nfjson_free(&v);
+    }
+}
+
+/* every vector kernel the CPU runs agrees with the scalar check on random near-UTF-8 */
+static void test_utf8_kernels() {
+    static const char *pieces[] = {
+        "a", "\x7F", "abcdefghijklmnopqrstuvwxyz0123456", "\xC2\xA2", "\xDF\xBF", "\xE0\xA0\x80", "\xE2\x82\xAC", "\xED\x9F\xBF", "\xEF\xBF\xBF",
+        "\xF0\x90\x80\x80", "\xF4\x8F\xBF\xBF", "\x80", "\xBF", "\xC0\xAF", "\xC1", "\xE0\x9F\xBF", "\xED\xA0\x80",
+        "\xF0\x8F\xBF\xBF", "\xF4\x90\x80\x80", "\xF5", "\xFF", "\xE2\x82", "\xF0\x9D\x84"
+    };
+    char buf[160];
+    size_t len, i;
+    int round, kernel, expect;
+    unsigned int seed = 12345;
+    for (round = 0; round < 20000; round++) {
+        for (len = 0;;) {
+            seed = seed * 1103515245 + 12345;
+            i = (seed >> 16) % (round & 1 ? 23 : 11);//odd rounds mix in bad sequences
+            if (len + strlen(pieces[i]) > sizeof(buf) - 8 * (seed >> 28)) break;
+            memcpy(buf + len, pieces[i], strlen(pieces[i]));
+            len += strlen(pieces[i]);
+        }
+        if (round & 2) {//flip one bit
+            seed = seed * 1103515245 + 12345;
+            if (len) buf[(seed >> 8) % len] ^= (char)(1 << (seed >> 28) % 8);
+        }
+        expect = nfjson_utf8_valid_kernel(NFJSON_UTF8_SCALAR, buf, len);
+        for (kernel = NFJSON_UTF8_SCALAR + 1; kernel <= nfjson_utf8_kernel(); kernel++)
+            EXPECT_EQ_INT(expect, nfjson_utf8_valid_kernel(kernel, buf, len));
+    }
+}
+
 #define TEST_ARRAY_LITERAL(expect, array, index) \
             EXPECT_EQ_INT(expect, nfjson_get_type(nfjson_get_array_element(array, (index))))
 
@@ -335,7 +516,8 @@ static void test_parse_miss_comma_or_square_bracket() {
 }
 
 #define EXPECT_EQ_POINTER(expect, actual) \
-    EXPECT_EQ_BASE((uintptr_t)(expect) == (uintptr_t)(actual), (uintptr_t)(expect), (uintptr_t)(actual), "0x%llu")
+    EXPECT_EQ_BASE((uintptr_t)(expect) == (uintptr_t)(actual), (unsigned long long)(uintptr_t)(expect),\
+                                                            (unsigned long long)(uintptr_t)(actual), "0x%llx")
 
 static void test_hash_table_char_key() {
     hash_table *table = new_hash_table(1, NULL, NULL, NULL, NULL);
@@ -366,6 +548,138 @@ static void test_hash_table_char_key() {
     hash_table_free(table);
 }
 
+static void test_hash_table_keep(void *ptr) {
+    (void)ptr;
+}
+
+static void test_hash_table_churn() {
+    /* deleted slots are used again, the table only grows with the keys it holds */
+    hash_table *table = new_hash_table(100, NULL, NULL, test_hash_table_keep, test_hash_table_keep);
+    char keys[50][16];
+    int i, round, size = table->table_size;
+    for (round = 0; round < 100; round++) {
+        for (i = 0; i < 50; i++) {
+            sprintf(keys[i], "r%dk%d", round, i);
+            EXPECT_EQ_POINTER(NULL, hash_table_put(table, keys[i], keys[i]));
+        }
+        EXPECT_EQ_POINTER(keys[round % 50], hash_table_put(table, keys[round % 50], keys[round % 50]));
+        for (i = 0; i < 50; i++) EXPECT_EQ_POINTER(keys[i], hash_table_get(table, keys[i]));
+        for (i = 0; i < 50; i++) EXPECT_EQ_POINTER(keys[i], hash_table_remove(table, keys[i]));
+        EXPECT_EQ_POINTER(NULL, hash_table_get(table, keys[0]));
+    }
+    EXPECT_EQ_INT(0, table->cnt);
+    EXPECT_EQ_INT(size, table->table_size);
+    hash_table_free(table);
+}
+
+/* op moves at most step old slots of table, the end of one growth and the start of the next included */
+#define TEST_MOVED_AT_MOST(step, table, op) \
+    do {\
+        kv *__old = (table)->old_table;\
+        int __moved = (table)->moved, __size = (table)->old_size, __n;\
+        op;\
+        if ((table)->old_table == __old) __n = __old ? (table)->moved - __moved : 0;\
+        else __n = (__old ? __size - __moved : 0) + ((table)->old_table ? (table)->moved : 0);\
+        EXPECT_TRUE(__n >= 0 && __n <= (step));\
+    } while (0)
+
+static void test_hash_table_incremental() {
+    /* keys stay found while they move. a step of 2 is done before the table grows again */
+    hash_table *table = new_hash_table(16, NULL, NULL, test_hash_table_keep, test_hash_table_keep);
+    char keys[1000][8];
+    int i, j, grew = 0;
+    hash_table_set_rehash_step(table, 2);
+    for (i = 0; i < 1000; i++) {
+        sprintf(keys[i], "k%d", i);
+        TEST_MOVED_AT_MOST(2, table, EXPECT_EQ_POINTER(NULL, hash_table_put(table, keys[i], keys[i])));
+        grew |= table->old_table != NULL;
+        if (i % 7 == 0) TEST_MOVED_AT_MOST(2, table, EXPECT_EQ_POINTER(keys[i / 2], hash_table_put(table, keys[i / 2], keys[i / 2])));
+        if (i % 50 == 0)
+            for (j = 0; j <= i; j++) TEST_MOVED_AT_MOST(2, table, EXPECT_EQ_POINTER(keys[j], hash_table_get(table, keys[j])));
+    }
+    EXPECT_TRUE(grew);
+    for (i = 0; i < 1000; i += 3) TEST_MOVED_AT_MOST(2, table, EXPECT_EQ_POINTER(keys[i], hash_table_remove(table, keys[i])));
+    for (i = 0; i < 1000; i++) EXPECT_EQ_POINTER(i % 3 ? keys[i] : NULL, hash_table_get(table, keys[i]));
+    EXPECT_EQ_INT(666, table->cnt);
+    hash_table_set_rehash_step(table, 0);
+    EXPECT_TRUE(table->old_table == NULL);
+    hash_table_free(table);
+}
+
+static unsigned int test_nfjson_string_hash(void *key) {
+    return hash_table_hash(((nfjson_string *)key)->s, ((nfjson_string *)key)->len);
+}
+
+static int test_nfjson_string_cmp(const void *k, const void *key) {
+    const nfjson_string *a = (const nfjson_string *)k, *b = (const nfjson_string *)key;
+    return a->len == b->len && memcmp(a->s, b->s, a->len) == 0;
+}
+
+static void test_hash_table_bulk() {
+    /* fixed-size keys side by side, then member keys inside an array of structs */
+    char keys[40][8], vals[40][8];
+    nfjson_member m[3];
+    hash_table *table;
+    int i, size;
+    for (i = 0; i < 40; i++) {
+        sprintf(keys[i], "k%d", i % 30);
+        sprintf(vals[i], "v%d", i);
+    }
+    table = new_hash_table_bulk(40, keys, sizeof(keys[0]), vals, sizeof(vals[0]), NULL, NULL,
+                                                            test_hash_table_keep, test_hash_table_keep, NULL, NULL);
+    size = table->table_size;
+    EXPECT_EQ_INT(30, table->cnt);
+    EXPECT_EQ_POINTER(vals[35], hash_table_get(table, "k5"));
+    EXPECT_EQ_POINTER(vals[29], hash_table_get(table, "k29"));
+    for (i = 0; i < 10; i++) EXPECT_EQ_POINTER(vals[i + 30], hash_table_put(table, keys[i], vals[i]));
+    EXPECT_EQ_INT(size, table->table_size);
+    hash_table_free(table);
+
+    m[0].key = m[2].key = (nfjson_string) { "a", 1 };
+    m[1].key = (nfjson_string) { "bc", 2 };
+    table = new_hash_table_bulk(3, &m->key, sizeof(nfjson_member), m, sizeof(nfjson_member), test_nfjson_string_hash,
+                                                            test_nfjson_string_cmp, test_hash_table_keep, test_hash_table_keep, NULL, NULL);
+    EXPECT_EQ_INT(2, table->cnt);
+    EXPECT_EQ_POINTER(m + 2, hash_table_get(table, &(nfjson_string) { "a", 1 }));
+    EXPECT_EQ_POINTER(m + 1, hash_table_get(table, &(nfjson_string) { "bc", 2 }));
+    hash_table_free(table);
+}
+
+static int test_cmp_uint(const void *a, const void *b) {
+    return *(const unsigned int *)a < *(const unsigned int *)b ? -1 : *(const unsigned int *)a > *(const unsigned int *)b;
+}
+
+static void test_hash_table_flood() {
+    /* "bA" and "AB" weigh the same in a times-33 hash, keys made of them all collided there */
+    size_t n = 1 << 14, i, j, len = 0, distinct = 1;
+    char *json = (char *)malloc(n * 40), key[29];
+    unsigned int *hashes = (unsigned int *)malloc(sizeof(unsigned int) * n);
+    nfjson_document doc;
+    hash_table *index;
+    json[len++] = '{';
+    for (i = 0; i < n; i++) {
+        json[len++] = '"';
+        for (j = 0; j < 14; j++, len += 2) memcpy(json + len, i >> j & 1 ? "bA" : "AB", 2);
+        len += sprintf(json + len, "\":%d,", (int)i);
+    }
+    json[len - 1] = '}';
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_document_n(&doc, json, len));
+    EXPECT_EQ_SIZE_T(n, nfjson_get_object_size(&doc.root));
+    index = doc.root.u.o->index;
+    for (i = 0, j = 0; i < (size_t)index->table_size; i++) if (!(index->ctrl[i] & 0x80)) hashes[j++] = index->table[i].hash;
+    qsort(hashes, n, sizeof(unsigned int), test_cmp_uint);
+    for (i = 1; i < n; i++) distinct += hashes[i] != hashes[i - 1];
+    EXPECT_TRUE(distinct + 4 > n);
+    for (i = 0; i < n; i += 97) {
+        for (j = 0; j < 14; j++) memcpy(key + 2 * j, i >> j & 1 ? "bA" : "AB", 2);
+        EXPECT_EQ_INT((int)i, (int)nfjson_get_int64(nfjson_get_object_value(&doc.root, &(nfjson_string) { key, 28 })));
+    }
+    EXPECT_TRUE(nfjson_get_object_value(&doc.root, &(nfjson_string) { key, 27 }) == NULL);
+    nfjson_document_free(&doc);
+    free(hashes);
+    free(json);
+}
+
 static unsigned int hashcode(nfjson_string *key) {
     unsigned int hash = 0;
     int i;
@@ -418,6 +732,8 @@ static void test_hash_table_nfjson_string_key() {
 }
 
 static void test_parse_miss_key() {
+    TEST_ERROR(NFJSON_PARSE_MISS_KEY, "{");
+    TEST_ERROR(NFJSON_PARSE_MISS_KEY, "{ ");
     TEST_ERROR(NFJSON_PARSE_MISS_KEY, "{:1,");
     TEST_ERROR(NFJSON_PARSE_MISS_KEY, "{1:1,");
     TEST_ERROR(NFJSON_PARSE_MISS_KEY, "{true:1,");
@@ -488,7 +804,7 @@ static void test_parse_object() {
     EXPECT_TRUE(nfjson_object_contains(&v, &(nfjson_string) { "n", 1 }));
     EXPECT_FALSE(nfjson_object_contains(&v, &(nfjson_string) { "n\0", 2 }));
     EXPECT_TRUE(nfjson_object_contains(&v, &(nfjson_string) { "n\0", 1 }));//concerned func hashcode in parse.c
-    EXPECT_FALSE(nfjson_object_contains(&v, &(nfjson_string) { "n2", 1 }));
+    EXPECT_TRUE(nfjson_object_contains(&v, &(nfjson_string) { "n2", 1 }));//keys are [s, s + len)
     EXPECT_EQ_INT(JSON_NULL, nfjson_get_type(nfjson_get_object_value(&v, &(nfjson_string) { "n", 1 })));
     EXPECT_TRUE(nfjson_object_contains(&v, &(nfjson_string) { "f", 1 }));
     EXPECT_EQ_INT(JSON_FALSE, nfjson_get_type(nfjson_get_object_value(&v, &(nfjson_string) { "f", 1 })));
@@ -530,6 +846,789 @@ static void test_parse_object() {
     nfjson_free(&v);
 }
 
+static void test_parse_object_members() {
+    nfjson_value v;
+    nfjson_document doc;
+    const nfjson_string *keys[20];
+    char json[256], *p = json, *text;
+    size_t len;
+    int i;
+    /* members keep the input order, a repeated key its first place and the last value */
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse(&v, "{\"b\":1,\"a\":[2],\"c\":3,\"a\":4}"));
+    EXPECT_EQ_SIZE_T(3, nfjson_get_object_key(&v, keys));
+    EXPECT_EQ_STRING("b", keys[0]->s, keys[0]->len);
+    EXPECT_EQ_STRING("a", keys[1]->s, keys[1]->len);
+    EXPECT_EQ_STRING("c", keys[2]->s, keys[2]->len);
+    text = nfjson_stringify(&v, &len, NULL);
+    EXPECT_EQ_STRING("{\"b\":1,\"a\":4,\"c\":3}", text, len);
+    free(text);
+    nfjson_free(&v);
+
+    /* indexed from the start */
+    p += sprintf(p, "{");
+    for (i = 0; i < 20; i++) p += sprintf(p, "\"k%d\":%d,", i, i);
+    sprintf(p, "\"k7\":70}");
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_document(&doc, json));
+    EXPECT_TRUE(doc.root.u.o->index != NULL);
+    EXPECT_EQ_SIZE_T(20, nfjson_get_object_key(&doc.root, keys));
+    EXPECT_EQ_STRING("k19", keys[19]->s, keys[19]->len);
+    EXPECT_EQ_NUMBER(70.0, nfjson_get_number(nfjson_get_object_value(&doc.root, &(nfjson_string) { "k7", 2 })));
+    EXPECT_TRUE(nfjson_get_object_value(&doc.root, &(nfjson_string) { "k20", 3 }) == NULL);
+    nfjson_document_free(&doc);
+
+    /* indexed once looked up often enough */
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse(&v, "{\"a\":0,\"b\":1,\"c\":2,\"d\":3,\"e\":4,\"f\":5,\"g\":6,\"h\":7,\"i\":8,\"j\":9}"));
+    EXPECT_TRUE(v.u.o->index == NULL);
+    for (i = 0; i < NFJSON_OBJECT_INDEX_LOOKUPS; i++)
+        EXPECT_EQ_NUMBER((double)(i % 10), nfjson_get_number(nfjson_get_object_value(&v, &(nfjson_string) { (char *)"abcdefghij" + i % 10, 1 })));
+    EXPECT_TRUE(v.u.o->index != NULL);
+    EXPECT_EQ_NUMBER(9.0, nfjson_get_number(nfjson_get_object_value(&v, &(nfjson_string) { "j", 1 })));
+    EXPECT_FALSE(nfjson_object_contains(&v, &(nfjson_string) { "k", 1 }));
+    nfjson_free(&v);
+
+    /* lookups never change a document */
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_document(&doc, "{\"a\":0,\"b\":1,\"c\":2,\"d\":3,\"e\":4,\"f\":5,\"g\":6,\"h\":7,\"i\":8,\"j\":9}"));
+    for (i = 0; i < 2 * NFJSON_OBJECT_INDEX_LOOKUPS; i++)
+        EXPECT_EQ_NUMBER((double)(i % 10), nfjson_get_number(nfjson_get_object_value(&doc.root, &(nfjson_string) { (char *)"abcdefghij" + i % 10, 1 })));
+    EXPECT_TRUE(doc.root.u.o->index == NULL);
+    EXPECT_EQ_SIZE_T(0, doc.root.u.o->lookups);
+    nfjson_document_free(&doc);
+}
+
+static void test_parse_object_key() {
+    nfjson_document doc;
+    nfjson_key price = nfjson_key_make("price"), k19 = nfjson_key_make("k19"), none = nfjson_key_make_n("pricey", 5);
+    char json[512], *p = json;
+    size_t i;
+    /* same shape, then another one, an empty object and an indexed one */
+    p += sprintf(p, "[{\"id\":1,\"price\":10},{\"id\":2,\"price\":20},{\"price\":30,\"id\":3},{},{");
+    for (i = 0; i < 20; i++) p += sprintf(p, "\"k%d\":%d,", (int)i, (int)i);
+    sprintf(p, "\"price\":40}]");
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_document(&doc, json));
+    for (i = 0; i < 2; i++) {
+        EXPECT_EQ_NUMBER(10.0 * (i + 1), nfjson_get_number(nfjson_get_object_value_by_key(nfjson_get_array_element(&doc.root, i), &price)));
+        EXPECT_EQ_SIZE_T(1, price.pos);
+    }
+    EXPECT_EQ_NUMBER(30.0, nfjson_get_number(nfjson_get_object_value_by_key(nfjson_get_array_element(&doc.root, 2), &price)));
+    EXPECT_EQ_SIZE_T(0, price.pos);
+    EXPECT_FALSE(nfjson_object_contains_key(nfjson_get_array_element(&doc.root, 3), &price));
+    EXPECT_EQ_NUMBER(40.0, nfjson_get_number(nfjson_get_object_value_by_key(nfjson_get_array_element(&doc.root, 4), &price)));
+    EXPECT_EQ_SIZE_T(20, price.pos);
+    EXPECT_EQ_NUMBER(19.0, nfjson_get_number(nfjson_get_object_value_by_key(nfjson_get_array_element(&doc.root, 4), &k19)));
+    EXPECT_FALSE(nfjson_object_contains_key(nfjson_get_array_element(&doc.root, 1), &k19));
+    EXPECT_TRUE(nfjson_object_contains_key(nfjson_get_array_element(&doc.root, 0), &none));
+    nfjson_document_free(&doc);
+}
+
+static char *test_nested(size_t depth, const char *open, const char *inner, const char *close) {
+    size_t lo = strlen(open), li = strlen(inner), lc = strlen(close), i;
+    char *json = (char *)malloc(depth * (lo + lc) + li + 1), *p = json;
+    for (i = 0; i < depth; i++, p += lo) memcpy(p, open, lo);
+    memcpy(p, inner, li); p += li;
+    for (i = 0; i < depth; i++, p += lc) memcpy(p, close, lc);
+    *p = 0;
+    return json;
+}
+
+static void test_parse_depth() {
+    nfjson_value v;
+    nfjson_document doc;
+    nfjson_parse_options opts = { .max_depth = 2 };
+    char *json;
+
+    json = test_nested(NFJSON_PARSE_MAX_DEPTH, "[", "1", "]");
+    TEST_OK(JSON_ARRAY, json);
+    free(json);
+    json = test_nested(NFJSON_PARSE_MAX_DEPTH + 1, "[", "1", "]");
+    TEST_ERROR(NFJSON_PARSE_TOO_DEEP, json);
+    free(json);
+    json = test_nested(NFJSON_PARSE_MAX_DEPTH / 2 + 1, "{\"a\":[", "", "]}");
+    TEST_ERROR(NFJSON_PARSE_TOO_DEEP, json);
+    free(json);
+    /* hostile input fails early instead of exhausting the native stack */
+    json = test_nested(1000000, "[", "", "");
+    TEST_ERROR(NFJSON_PARSE_TOO_DEEP, json);
+    free(json);
+
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_opts(&v, "[[1],{\"a\":1}]", 13, &opts));
+    nfjson_free(&v);
+    EXPECT_EQ_INT(NFJSON_PARSE_TOO_DEEP, nfjson_parse_opts(&v, "[[[1]]]", 7, &opts));
+    EXPECT_EQ_INT(NFJSON_PARSE_TOO_DEEP, nfjson_parse_opts(&v, "{\"a\":{\"b\":[]}}", 14, &opts));
+    EXPECT_EQ_INT(JSON_UNRESOLVED, nfjson_get_type(&v));
+
+    /* partial containers of every open level are released */
+    TEST_ERROR(NFJSON_PARSE_INVALID_VALUE, "[{\"a\":[1,{\"b\":tru}]},2]");
+    TEST_ERROR(NFJSON_PARSE_MISS_COLON, "{\"a\":[\"x\",{\"b\":[],\"c\" 1}]}");
+    opts.max_depth = 2000000;
+    json = test_nested(1000000, "[", "", "");
+    EXPECT_EQ_INT(NFJSON_PARSE_EXPECT_VALUE, nfjson_parse_opts(&v, json, 1000000, &opts));
+    EXPECT_EQ_INT(NFJSON_PARSE_EXPECT_VALUE, nfjson_parse_document_opts(&doc, json, 1000000, &opts));
+    free(json);
+    /* the arena document is released without recursion */
+    json = test_nested(1000000, "[", "", "]");
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_document_opts(&doc, json, 2000000, &opts));
+    EXPECT_EQ_INT(JSON_ARRAY, nfjson_get_type(&doc.root));
+    nfjson_document_free(&doc);
+    free(json);
+
+    /* repeated names keep the last value */
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse(&v, "{\"a\":[1],\"a\":2}"));
+    EXPECT_EQ_SIZE_T(1, nfjson_get_object_size(&v));
+    nfjson_free(&v);
+}
+
+static void test_parse_document() {
+    nfjson_document doc;
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_document(&doc,
+        "{\"n\":null,\"s\":\"abc\",\"a\":[1,[2,\"x\"],{\"k\":\"v\"}],\"o\":{\"1\":1,\"1\":2}}"));
+    EXPECT_EQ_INT(JSON_OBJECT, nfjson_get_type(&doc.root));
+    EXPECT_EQ_SIZE_T(4, nfjson_get_object_size(&doc.root));
+    nfjson_value *v = nfjson_get_object_value(&doc.root, &(nfjson_string) { "s", 1 });
+    EXPECT_EQ_STRING("abc", nfjson_get_string(v), nfjson_get_string_length(v));
+    v = nfjson_get_object_value(&doc.root, &(nfjson_string) { "a", 1 });
+    EXPECT_EQ_SIZE_T(3, nfjson_get_array_size(v));
+    TEST_ARRAY_STRING("x", nfjson_get_array_element(v, 1), 1);
+    v = nfjson_get_object_value(&doc.root, &(nfjson_string) { "o", 1 });
+    EXPECT_EQ_SIZE_T(1, nfjson_get_object_size(v));
+    EXPECT_EQ_NUMBER(2, nfjson_get_number(nfjson_get_object_value(v, &(nfjson_string) { "1", 1 })));
+    nfjson_document_free(&doc);
+
+    EXPECT_EQ_INT(NFJSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET, nfjson_parse_document(&doc, "{\"a\":[1,2,{\"b\":\"c\"}],\"d\":{}"));
+    EXPECT_EQ_INT(JSON_UNRESOLVED, nfjson_get_type(&doc.root));
+    EXPECT_EQ_POINTER(NULL, doc.arena.chunk);
+    nfjson_document_free(&doc);
+    EXPECT_EQ_INT(NFJSON_PARSE_INVALID_VALUE, nfjson_parse_document(&doc, "[[\"a\", {\"b\":[nul]}]]"));
+    nfjson_document_free(&doc);
+}
+
+static void test_parse_document_lazy() {
+    nfjson_document doc, full;
+    const nfjson_string *keys[6];
+    const char *json = " {\"n\":null, \"s\" : \"a\\\"bc\", \"a\":[1, [2,\"x\"] ,{\"k\\u0041\":\"v\"}, -7e1],"
+        "\"o\":{\"1\":1,\"1\":2}, \"e\":[], \"big\":18446744073709551615} ";
+    char *expect, *actual;
+    size_t expect_len, actual_len;
+    int status;
+    nfjson_value *v;
+
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_document_lazy(&doc, json, strlen(json)));
+    EXPECT_EQ_INT(JSON_OBJECT, nfjson_get_type(&doc.root));
+    EXPECT_EQ_SIZE_T(6, nfjson_get_object_size(&doc.root));
+    /* members stay undecoded until reached */
+    EXPECT_EQ_INT(JSON_LAZY, doc.root.u.o->m[2].val.type);
+    v = nfjson_get_object_value(&doc.root, &(nfjson_string) { "s", 1 });
+    EXPECT_EQ_STRING("a\"bc", nfjson_get_string(v), nfjson_get_string_length(v));
+    v = nfjson_get_object_value(&doc.root, &(nfjson_string) { "a", 1 });
+    EXPECT_EQ_SIZE_T(4, nfjson_get_array_size(v));
+    EXPECT_EQ_INT(JSON_LAZY, v->u.a.e[1].type);
+    TEST_ARRAY_STRING("x", nfjson_get_array_element(v, 1), 1);
+    EXPECT_EQ_NUMBER(-70, nfjson_get_number(nfjson_get_array_element(v, 3)));
+    v = nfjson_get_array_element(v, 2);
+    EXPECT_EQ_STRING("v", nfjson_get_string(nfjson_get_object_value(v, &(nfjson_string) { "kA", 2 })), 1);
+    /* decoded text is copied out of the json and terminated */
+    EXPECT_EQ_SIZE_T(1, strlen(nfjson_get_string(nfjson_get_object_value(v, &(nfjson_string) { "kA", 2 }))));
+    EXPECT_TRUE(nfjson_get_string(nfjson_get_object_value(v, &(nfjson_string) { "kA", 2 })) < json
+        || nfjson_get_string(nfjson_get_object_value(v, &(nfjson_string) { "kA", 2 })) > json + strlen(json));
+    nfjson_get_object_key(&doc.root, keys);
+    EXPECT_EQ_SIZE_T(1, strlen(keys[0]->s));
+    v = nfjson_get_object_value(&doc.root, &(nfjson_string) { "o", 1 });
+    EXPECT_EQ_SIZE_T(1, nfjson_get_object_size(v));
+    EXPECT_EQ_NUMBER(2, nfjson_get_number(nfjson_get_object_value(v, &(nfjson_string) { "1", 1 })));
+    EXPECT_EQ_SIZE_T(0, nfjson_get_array_size(nfjson_get_object_value(&doc.root, &(nfjson_string) { "e", 1 })));
+
+    /* whatever is left is decoded on the way out, like a full parse */
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_document_n(&full, json, strlen(json)));
+    expect = nfjson_stringify(&full.root, &expect_len, &status);
+    actual = nfjson_stringify(&doc.root, &actual_len, &status);
+    EXPECT_EQ_BASE(expect_len == actual_len && memcmp(expect, actual, actual_len) == 0, expect, actual, "%s");
+    free(expect);
+    free(actual);
+    nfjson_document_free(&full);
+    nfjson_document_free(&doc);
+
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_document_lazy(&doc, " \"\\u00e9\" ", 10));
+    EXPECT_EQ_STRING("\xC3\xA9", nfjson_get_string(&doc.root), nfjson_get_string_length(&doc.root));
+    nfjson_document_free(&doc);
+
+    /* the whole json is checked up front */
+    EXPECT_EQ_INT(NFJSON_PARSE_INVALID_VALUE, nfjson_parse_document_lazy(&doc, "{\"a\":1,\"b\":[tru]}", 18));
+    EXPECT_EQ_INT(JSON_UNRESOLVED, nfjson_get_type(&doc.root));
+    EXPECT_EQ_POINTER(NULL, doc.arena.chunk);
+    nfjson_document_free(&doc);
+}
+
+#define TEST_N(expect, json, len, json_type) \
+                do{\
+                    nfjson_value __v;\
+                    EXPECT_EQ_INT(expect, nfjson_parse_n(&__v, json, len));\
+                    EXPECT_EQ_INT(json_type, nfjson_get_type(&__v));\
+                    nfjson_free(&__v);\
+                } while (0)
+
+static void test_parse_n() {
+    TEST_N(NFJSON_PARSE_OK, "[1,2]xyz", 5, JSON_ARRAY);
+    TEST_N(NFJSON_PARSE_OK, "123456", 3, JSON_NUMBER);
+    TEST_N(NFJSON_PARSE_OK, "[0]", 3, JSON_ARRAY);
+    TEST_N(NFJSON_PARSE_OK, "{\"a\":0}", 7, JSON_OBJECT);
+    TEST_N(NFJSON_PARSE_OK, "\"\xC3\xA9\"", 4, JSON_STRING);
+    TEST_N(NFJSON_PARSE_EXPECT_VALUE, "null", 0, JSON_UNRESOLVED);
+    TEST_N(NFJSON_PARSE_INVALID_VALUE, "true", 3, JSON_UNRESOLVED);
+    TEST_N(NFJSON_PARSE_INVALID_VALUE, "\0", 1, JSON_UNRESOLVED);
+    TEST_N(NFJSON_PARSE_INVALID_VALUE, "1e5", 2, JSON_UNRESOLVED);
+    TEST_N(NFJSON_PARSE_ROOT_NOT_SINGULAR, "null\0", 5, JSON_NULL);
+    TEST_N(NFJSON_PARSE_INVALID_STRING_CHAR, "\"a\0b\"", 5, JSON_UNRESOLVED);
+    TEST_N(NFJSON_PARSE_MISS_QUOTATION_MARK, "\"abc\"", 4, JSON_UNRESOLVED);
+    TEST_N(NFJSON_PARSE_MISS_QUOTATION_MARK, "\"a\\n\"", 3, JSON_UNRESOLVED);
+    TEST_N(NFJSON_PARSE_INVALID_UNICODE_HEX, "\"\\u0041\"", 6, JSON_UNRESOLVED);
+    TEST_N(NFJSON_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD834\\uDD1E\"", 8, JSON_UNRESOLVED);
+    TEST_N(NFJSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1,2]", 4, JSON_UNRESOLVED);
+    TEST_N(NFJSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":1}", 6, JSON_UNRESOLVED);
+
+    nfjson_value v;
+    char padded[4 + NFJSON_PADDING] = "[\"\"]";
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_padded(&v, padded, 4));
+    EXPECT_EQ_SIZE_T(1, nfjson_get_array_size(&v));
+    nfjson_free(&v);
+    nfjson_document doc;
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_document_n(&doc, "[\"a\",1]]", 7));
+    EXPECT_EQ_SIZE_T(2, nfjson_get_array_size(&doc.root));
+    nfjson_document_free(&doc);
+}
+
+static void test_parse_whitespace_runs() {
+    /* escapes and whitespace runs crossing 16 byte string scan blocks, the tail without padding */
+    size_t n = 4096, i, len;
+    char *json = (char *)malloc(n * 64 + 16), *p = json;
+    p += sprintf(p, "[\n");
+    for (i = 0; i < n; i++)
+        p += sprintf(p, "  { \"k\\\"%zu\" :\t\"v\\\\\" , \"n\" : %zu }%s", i, i, i + 1 < n ? " ,\r\n" : "\n");
+    p += sprintf(p, "]  ");
+    len = (size_t)(p - json);
+    nfjson_value v;
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_n(&v, json, len));
+    EXPECT_EQ_INT(JSON_ARRAY, nfjson_get_type(&v));
+    EXPECT_EQ_SIZE_T(n, nfjson_get_array_size(&v));
+    nfjson_value *e = nfjson_get_array_element(&v, n - 1);
+    EXPECT_EQ_INT((int)(n - 1), (int)nfjson_get_int64(nfjson_get_object_value(e, &(nfjson_string) { "n", 1 })));
+    nfjson_free(&v);
+    memcpy(json + len - 2, " x", 2);
+    EXPECT_EQ_INT(NFJSON_PARSE_ROOT_NOT_SINGULAR, nfjson_parse_n(&v, json, len));
+    nfjson_free(&v);
+    json[len - 3] = ',';
+    EXPECT_EQ_INT(NFJSON_PARSE_INVALID_VALUE, nfjson_parse_n(&v, json, len));
+    free(json);
+}
+
+/* every chunk size must give what nfjson_parse_n gives on the whole json */
+static void test_stream(const char *json) {
+    size_t len = strlen(json), step, i, n, expect_len, actual_len;
+    nfjson_value expect, actual;
+    nfjson_parser p;
+    int expect_status = nfjson_parse_n(&expect, json, len), status, stringify_status;
+    char *expect_json = NULL, *actual_json;
+    if (expect.type != JSON_UNRESOLVED) expect_json = nfjson_stringify(&expect, &expect_len, &stringify_status);
+    for (step = 1; step <= len; step++) {
+        nfjson_parser_init(&p, &actual, NULL);
+        for (i = 0, status = NFJSON_PARSE_OK; i < len && status == NFJSON_PARSE_OK; i += n) {
+            n = len - i < step ? len - i : step;
+            status = nfjson_parser_feed(&p, json + i, n);
+        }
+        EXPECT_EQ_INT(expect_status, nfjson_parser_finish(&p));
+        nfjson_parser_free(&p);
+        EXPECT_EQ_INT(expect.type, actual.type);
+        if (expect_json && actual.type == expect.type) {
+            actual_json = nfjson_stringify(&actual, &actual_len, &stringify_status);
+            EXPECT_EQ_BASE(expect_len == actual_len && memcmp(expect_json, actual_json, actual_len) == 0, expect_json, actual_json, "%s");
+            free(actual_json);
+        }
+        nfjson_free(&actual);
+    }
+    free(expect_json);
+    nfjson_free(&expect);
+}
+
+static void test_parse_stream() {
+    nfjson_parser p;
+    nfjson_document doc;
+    nfjson_value v;
+
+    test_stream(" [ null , true,false, -12.5e-3, 18446744073709551615, \"a\\\"b\\\\c\\u00e9\\uD834\\uDD1E\" ] ");
+    test_stream("{\"key\" : {\"\\u0041\":[[], {}, 0, \"\"]}, \"k2\" :-0.0}");
+    test_stream("\"split \\\\\\\" escapes\"");
+    test_stream("123456789.25e2");
+    test_stream("tru");
+    test_stream("[1,]");
+    test_stream("[,1]");
+    test_stream("{\"a\" 1}");
+    test_stream("{\"a\\x\":1}");
+    test_stream("[\"\\u12\"]");
+    test_stream("[0123]");
+    test_stream("nullx");
+    test_stream("[1.]");
+    test_stream(" 7 ,");
+    test_stream("");
+
+    /* into a document, the chunks are gone before finish */
+    nfjson_parser_init_document(&p, &doc, NULL);
+    {
+        char chunk[8];
+        memcpy(chunk, "{\"name\":", 8); EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parser_feed(&p, chunk, 8));
+        memcpy(chunk, "\"value\",", 8); EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parser_feed(&p, chunk, 6));
+        memcpy(chunk, "e\"}xxxxx", 8); EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parser_feed(&p, chunk, 3));
+    }
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parser_finish(&p));
+    nfjson_parser_free(&p);
+    EXPECT_EQ_STRING("value", nfjson_get_string(nfjson_get_object_value(&doc.root, &(nfjson_string) { "name", 4 })), 5);
+    nfjson_document_free(&doc);
+
+    /* errors stick, and a parser dropped halfway releases what it built */
+    nfjson_parser_init(&p, &v, NULL);
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parser_feed(&p, "[{\"a\":[\"x\",", 11));
+    EXPECT_EQ_INT(NFJSON_PARSE_INVALID_VALUE, nfjson_parser_feed(&p, "x]}]", 4));
+    EXPECT_EQ_INT(NFJSON_PARSE_INVALID_VALUE, nfjson_parser_feed(&p, "]", 1));
+    EXPECT_EQ_INT(NFJSON_PARSE_INVALID_VALUE, nfjson_parser_finish(&p));
+    nfjson_parser_free(&p);
+    EXPECT_EQ_INT(JSON_UNRESOLVED, nfjson_get_type(&v));
+    nfjson_parser_init(&p, &v, NULL);
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parser_feed(&p, "{\"a\":[1,{\"b\":\"unterminated", 26));
+    nfjson_parser_free(&p);
+    nfjson_parser_init_document(&p, &doc, NULL);
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parser_feed(&p, "[[1,2],{\"a\":", 12));
+    nfjson_parser_free(&p);
+    EXPECT_EQ_POINTER(NULL, doc.arena.chunk);
+}
+
+/* writes one letter per event into trace, stops once limit events are taken */
+typedef struct {
+    char trace[256];
+    size_t len, limit;
+}sax_recorder;
+
+static int sax_record(void *ctx, char event, const char *s, size_t len) {
+    sax_recorder *r = (sax_recorder *)ctx;
+    if (r->len + 1 + len < sizeof(r->trace)) {
+        r->trace[r->len++] = event;
+        if (len) memcpy(r->trace + r->len, s, len);
+        r->len += len;
+        r->trace[r->len] = 0;
+    }
+    return --r->limit != 0;
+}
+static int sax_null(void *ctx) { return sax_record(ctx, 'n', NULL, 0); }
+static int sax_boolean(void *ctx, int b) { return sax_record(ctx, b ? 't' : 'f', NULL, 0); }
+static int sax_number(void *ctx, const nfjson_value *num) {
+    return sax_record(ctx, nfjson_get_number_type(num) == NFJSON_NUMBER_DOUBLE ? 'd' : 'i', NULL, 0);
+}
+static int sax_string(void *ctx, const char *s, size_t len) { return sax_record(ctx, 's', s, len); }
+static int sax_key(void *ctx, const char *s, size_t len) { return sax_record(ctx, 'k', s, len); }
+static int sax_start_object(void *ctx) { return sax_record(ctx, '{', NULL, 0); }
+static int sax_start_array(void *ctx) { return sax_record(ctx, '[', NULL, 0); }
+static int sax_end(void *ctx, size_t count) { return sax_record(ctx, (char)('0' + count), "]", 1); }
+static const nfjson_sax_handler sax_recorder_handler = {
+    sax_null, sax_boolean, sax_number, sax_string, sax_key, sax_start_object, sax_end, sax_start_array, sax_end
+};
+
+#define TEST_SAX(expect_status, expect_trace, json, limit)\
+    do {\
+        sax_recorder r = { "", 0, (limit) };\
+        EXPECT_EQ_INT(expect_status, nfjson_parse_sax(&sax_recorder_handler, &r, json, strlen(json), NULL));\
+        EXPECT_EQ_STRING(expect_trace, r.trace, strlen(expect_trace));\
+    } while(0)
+
+static void test_parse_sax() {
+    nfjson_sax_handler empty = { NULL };
+    nfjson_parser p;
+    sax_recorder r = { "", 0, 0 };
+    const char *json = "{\"a\":[1,-2.5,\"x\\ty\"],\"b\":{}}";
+    size_t i;
+
+    TEST_SAX(NFJSON_PARSE_OK, "n", " null ", 0);
+    TEST_SAX(NFJSON_PARSE_OK, "[tfnid[0]6]", "[true,false,null,7,0.5,[]]", 0);
+    TEST_SAX(NFJSON_PARSE_OK, "{ka[ii2]kb[sx\ty1]2]", "{\"a\":[1,2],\"b\":[\"x\\ty\"]}", 0);
+    /* events already reported stay reported, the error comes last */
+    TEST_SAX(NFJSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[i", "[1 2]", 0);
+    TEST_SAX(NFJSON_PARSE_ROOT_NOT_SINGULAR, "i", "1 2", 0);
+    TEST_SAX(NFJSON_PARSE_INVALID_VALUE, "{ka", "{\"a\":nul}", 0);
+    /* a callback returning 0 ends the parse at once */
+    TEST_SAX(NFJSON_PARSE_STOPPED, "[[", "[[1],2]", 2);
+    TEST_SAX(NFJSON_PARSE_STOPPED, "{ka", "{\"a\":1,\"b\":2}", 2);
+    TEST_SAX(NFJSON_PARSE_STOPPED, "[[0]", "[[],[2]]", 3);
+    TEST_SAX(NFJSON_PARSE_STOPPED, "i", "5", 1);
+
+    /* NULL callbacks only validate */
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_sax(&empty, NULL, json, strlen(json), NULL));
+    EXPECT_EQ_INT(NFJSON_PARSE_MISS_KEY, nfjson_parse_sax(&empty, NULL, "{1:2}", 5, NULL));
+
+    /* the same events from chunks of one byte */
+    nfjson_parser_init_sax(&p, &sax_recorder_handler, &r, NULL);
+    for (i = 0; json[i]; i++) EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parser_feed(&p, json + i, 1));
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parser_finish(&p));
+    nfjson_parser_free(&p);
+    EXPECT_EQ_STRING("{ka[idsx\ty3]kb{0]2]", r.trace, r.len);
+}
+
+#define TEST_READER_TOKEN(expect_type, expect_depth, r)\
+    do {\
+        EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_reader_next(r));\
+        EXPECT_EQ_INT(expect_type, (r)->type);\
+        EXPECT_EQ_SIZE_T(expect_depth, (r)->depth);\
+    } while(0)
+
+static void test_parse_reader() {
+    nfjson_reader r;
+    const char *json = " {\"a\" : [1, \"x\\ny\", null], \"b\":{\"c\":[[true]]}, \"d\":-2.5} ";
+
+    nfjson_reader_init(&r, json, strlen(json), NULL);
+    TEST_READER_TOKEN(NFJSON_TOKEN_START_OBJECT, 0, &r);
+    TEST_READER_TOKEN(NFJSON_TOKEN_KEY, 1, &r);
+    EXPECT_EQ_STRING("a", r.s, r.len);
+    TEST_READER_TOKEN(NFJSON_TOKEN_START_ARRAY, 1, &r);
+    TEST_READER_TOKEN(NFJSON_TOKEN_NUMBER, 2, &r);
+    EXPECT_EQ_INT(1, (int)nfjson_get_int64(&r.num));
+    TEST_READER_TOKEN(NFJSON_TOKEN_STRING, 2, &r);
+    EXPECT_EQ_STRING("x\ny", r.s, r.len);
+    TEST_READER_TOKEN(NFJSON_TOKEN_NULL, 2, &r);
+    TEST_READER_TOKEN(NFJSON_TOKEN_END_ARRAY, 1, &r);
+    /* skip the whole "b" member */
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_reader_skip(&r));
+    EXPECT_EQ_INT(NFJSON_TOKEN_END_OBJECT, r.type);
+    EXPECT_EQ_SIZE_T(1, r.depth);
+    TEST_READER_TOKEN(NFJSON_TOKEN_KEY, 1, &r);
+    EXPECT_EQ_STRING("d", r.s, r.len);
+    TEST_READER_TOKEN(NFJSON_TOKEN_NUMBER, 1, &r);
+    EXPECT_EQ_NUMBER(-2.5, nfjson_get_number(&r.num));
+    TEST_READER_TOKEN(NFJSON_TOKEN_END_OBJECT, 0, &r);
+    TEST_READER_TOKEN(NFJSON_TOKEN_END, 0, &r);
+    TEST_READER_TOKEN(NFJSON_TOKEN_END, 0, &r);
+    nfjson_reader_free(&r);
+
+    nfjson_reader_init(&r, "\"root\"", 6, NULL);
+    TEST_READER_TOKEN(NFJSON_TOKEN_STRING, 0, &r);
+    EXPECT_EQ_STRING("root", r.s, r.len);
+    TEST_READER_TOKEN(NFJSON_TOKEN_END, 0, &r);
+    nfjson_reader_free(&r);
+
+    /* skipping still checks what it skips, errors stick */
+    nfjson_reader_init(&r, "[[1,{]], 2]", 11, NULL);
+    TEST_READER_TOKEN(NFJSON_TOKEN_START_ARRAY, 0, &r);
+    EXPECT_EQ_INT(NFJSON_PARSE_MISS_KEY, nfjson_reader_skip(&r));
+    EXPECT_EQ_INT(NFJSON_PARSE_MISS_KEY, nfjson_reader_next(&r));
+    EXPECT_EQ_INT(NFJSON_TOKEN_END, r.type);
+    nfjson_reader_free(&r);
+
+    nfjson_reader_init(&r, "1 2", 3, NULL);
+    TEST_READER_TOKEN(NFJSON_TOKEN_NUMBER, 0, &r);
+    EXPECT_EQ_INT(NFJSON_PARSE_ROOT_NOT_SINGULAR, nfjson_reader_next(&r));
+    nfjson_reader_free(&r);
+}
+
+/* keeps line, status and the number or array size of each record */
+typedef struct {
+    size_t line[64];
+    int status[64];
+    double n[64];
+    size_t count, limit;
+}ndjson_recorder;
+
+static int ndjson_record(void *ctx, size_t line, int status, nfjson_value *val) {
+    ndjson_recorder *r = (ndjson_recorder *)ctx;
+    if (r->count < 64) {
+        r->line[r->count] = line;
+        r->status[r->count] = status;
+        r->n[r->count] = val->type == JSON_NUMBER ? nfjson_get_number(val) :
+                         val->type == JSON_ARRAY ? (double)nfjson_get_array_size(val) : -1;
+    }
+    return ++r->count != r->limit;
+}
+
+static void test_parse_ndjson() {
+    const char *json = "1\n[1,2]\n\n  \r\n{\"a\":\ntru\r\n{\"s\":\"x\"}\n3 4\n7";
+    nfjson_pool *pool = nfjson_pool_new(4);
+    char *many;
+    size_t i;
+    int pass;
+
+    for (pass = 0; pass < 2; pass++) {
+        ndjson_recorder r = { { 0 }, { 0 }, { 0 }, 0, 0 };
+        EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_ndjson(pass ? pool : NULL, json, strlen(json), ndjson_record, &r, NULL));
+        EXPECT_EQ_SIZE_T(7, r.count);
+        EXPECT_EQ_SIZE_T(1, r.line[0]); EXPECT_EQ_INT(NFJSON_PARSE_OK, r.status[0]); EXPECT_EQ_NUMBER(1, r.n[0]);
+        EXPECT_EQ_SIZE_T(2, r.line[1]); EXPECT_EQ_NUMBER(2, r.n[1]);
+        EXPECT_EQ_SIZE_T(5, r.line[2]); EXPECT_EQ_INT(NFJSON_PARSE_EXPECT_VALUE, r.status[2]);
+        EXPECT_EQ_SIZE_T(6, r.line[3]); EXPECT_EQ_INT(NFJSON_PARSE_INVALID_VALUE, r.status[3]);
+        EXPECT_EQ_SIZE_T(7, r.line[4]); EXPECT_EQ_INT(NFJSON_PARSE_OK, r.status[4]);
+        EXPECT_EQ_SIZE_T(8, r.line[5]); EXPECT_EQ_INT(NFJSON_PARSE_ROOT_NOT_SINGULAR, r.status[5]);
+        EXPECT_EQ_SIZE_T(9, r.line[6]); EXPECT_EQ_NUMBER(7, r.n[6]);
+    }
+
+    /* more records than a batch, still in input order */
+    many = (char *)malloc(20000 * 8 + 1);
+    for (i = 0; i < 20000; i++) sprintf(many + i * 8, "[%5u]\n", (unsigned)(i % 64));
+    {
+        ndjson_recorder r = { { 0 }, { 0 }, { 0 }, 0, 0 };
+        EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_ndjson(pool, many, 20000 * 8, ndjson_record, &r, NULL));
+        EXPECT_EQ_SIZE_T(20000, r.count);
+        for (i = 0; i < 64; i++) EXPECT_EQ_SIZE_T(i + 1, r.line[i]);
+    }
+    {
+        ndjson_recorder r = { { 0 }, { 0 }, { 0 }, 0, 5000 };
+        EXPECT_EQ_INT(NFJSON_PARSE_STOPPED, nfjson_parse_ndjson(pool, many, 20000 * 8, ndjson_record, &r, NULL));
+        EXPECT_EQ_SIZE_T(5000, r.count);
+    }
+    free(many);
+    nfjson_pool_free(pool);
+}
+
+/* the parallel result against a sequential parse of the same json */
+static void test_parallel(nfjson_pool *pool, const char *json, size_t len) {
+    nfjson_value expect, actual;
+    char *expect_json = NULL, *actual_json;
+    size_t expect_len, actual_len;
+    int stringify_status;
+    EXPECT_EQ_INT(nfjson_parse_n(&expect, json, len), nfjson_parse_parallel(pool, &actual, json, len, NULL));
+    EXPECT_EQ_INT(expect.type, actual.type);
+    if (expect.type != JSON_UNRESOLVED && actual.type == expect.type) {
+        expect_json = nfjson_stringify(&expect, &expect_len, &stringify_status);
+        actual_json = nfjson_stringify(&actual, &actual_len, &stringify_status);
+        EXPECT_EQ_BASE(expect_len == actual_len && memcmp(expect_json, actual_json, actual_len) == 0, "", "", "%s");
+        free(actual_json);
+    }
+    free(expect_json);
+    nfjson_free(&expect);
+    nfjson_free(&actual);
+}
+
+static void test_parse_parallel() {
+    /* elements full of commas, brackets, quotes and backslashes that must not be cut */
+    static const char *elements[] = {
+        "\"a,b]\"", "[1,[2,\"]\"],{}]", "{\"k,\":\"\\\\\",\"v\":[\"\\\",\"]}", "-12.5e3", "\"\\\\\\\"[,\"", "null",
+        "{\"deep\":[[[[\"x\"]]]]}", "\"\\u005b,\"", "true", "[]"
+    };
+    size_t cap = NFJSON_PARALLEL_MIN_SIZE + 4096, len = 0, i;
+    char *json = (char *)malloc(cap);
+    nfjson_pool *pool = nfjson_pool_new(4);
+
+    json[len++] = '[';
+    for (i = 0; len < NFJSON_PARALLEL_MIN_SIZE; i++) {
+        if (i) json[len++] = ',';
+        if (i % 7 == 0) json[len++] = '\n';
+        len += sprintf(json + len, "%s", elements[i % 10]);
+    }
+    json[len++] = ']';
+    test_parallel(pool, json, len);
+    test_parallel(NULL, json, len);
+
+    /* errors come out as from the sequential parser */
+    json[len - 1] = ',';
+    test_parallel(pool, json, len);
+    json[len - 1] = ']';
+    memcpy(json + len / 2, "\"\"\"", 3);
+    test_parallel(pool, json, len);
+
+    /* anything but an array goes through nfjson_parse_opts */
+    json[0] = '{';
+    test_parallel(pool, json, len);
+    test_parallel(pool, "[1,2]", 5);
+    free(json);
+    nfjson_pool_free(pool);
+}
+
+static void test_parse_reuse() {
+    nfjson_parser p;
+    nfjson_document doc;
+    nfjson_value v;
+    const char *json = "[1,{\"tags\":[\"a\",\"b\\n\"]},true]", *text;
+    char *stack, *dom_stack;
+    nfjson_arena_chunk *chunk;
+    size_t len;
+    int i, status;
+
+    nfjson_parser_init_document(&p, &doc, NULL);
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parser_parse(&p, json, strlen(json)));
+    text = nfjson_parser_stringify(&p, &doc.root, &len, &status);
+    EXPECT_EQ_INT(NFJSON_STRINGIFY_OK, status);
+    EXPECT_EQ_STRING("[1,{\"tags\":[\"a\",\"b\\n\"]},true]", text, len);
+    stack = p.c.stack;
+    dom_stack = p.dom.stack;
+    chunk = doc.arena.chunk;
+    /* the same buffers serve every later json, errors included */
+    for (i = 0; i < 3; i++) {
+        EXPECT_EQ_INT(NFJSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, nfjson_parser_parse(&p, "[1,{\"tags\":[\"a\" \"b\"]}]", 23));
+        EXPECT_EQ_INT(JSON_UNRESOLVED, nfjson_get_type(&doc.root));
+        EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parser_parse(&p, json, strlen(json)));
+        EXPECT_EQ_SIZE_T(3, nfjson_get_array_size(&doc.root));
+        EXPECT_EQ_POINTER(text, nfjson_parser_stringify(&p, &doc.root, &len, &status));
+        EXPECT_EQ_SIZE_T(strlen(json), len);
+    }
+    EXPECT_EQ_POINTER(stack, p.c.stack);
+    EXPECT_EQ_POINTER(dom_stack, p.dom.stack);
+    EXPECT_EQ_POINTER(chunk, doc.arena.chunk);
+    nfjson_parser_free(&p);
+    nfjson_document_free(&doc);
+
+    /* nfjson_value results belong to the caller between parses */
+    nfjson_parser_init(&p, &v, NULL);
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parser_parse(&p, "[1,[2]]", 7));
+    EXPECT_EQ_SIZE_T(2, nfjson_get_array_size(&v));
+    nfjson_free(&v);
+    nfjson_parser_reset(&p);//a parsed json is finished, feeding another one starts over
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parser_feed(&p, "[3", 2));
+    nfjson_parser_reset(&p);
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parser_feed(&p, "\"x\"", 3));
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parser_finish(&p));
+    EXPECT_EQ_STRING("x", nfjson_get_string(&v), nfjson_get_string_length(&v));
+    nfjson_free(&v);
+    nfjson_parser_free(&p);
+}
+
+static void test_parse_file_write(const char *path, const char *json, size_t len) {
+    FILE *f = fopen(path, "wb");
+    fwrite(json, 1, len, f);
+    fclose(f);
+}
+
+static void test_parse_file() {
+    const char *path = "nfjson_test.json";
+    nfjson_document doc;
+    nfjson_value v;
+    char *big;
+
+    test_parse_file_write(path, " [\"mapped\",{\"a\":[1,2]}] ", 24);
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_file(&v, path, NULL));
+    EXPECT_EQ_SIZE_T(2, nfjson_get_array_size(&v));
+    EXPECT_EQ_STRING("mapped", nfjson_get_string(nfjson_get_array_element(&v, 0)), 6);
+    nfjson_free(&v);
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_document_file(&doc, path, NULL));
+    EXPECT_EQ_STRING("mapped", nfjson_get_string(nfjson_get_array_element(&doc.root, 0)), 6);
+    nfjson_document_free(&doc);
+
+    /* a file ending on a page boundary has no slack behind it */
+    big = (char *)malloc(4096);
+    memset(big, ' ', 4096);
+    big[0] = '[';
+    big[4093] = '1';
+    big[4094] = '2';
+    big[4095] = ']';
+    test_parse_file_write(path, big, 4096);
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_file(&v, path, NULL));
+    EXPECT_EQ_NUMBER(12.0, nfjson_get_number(nfjson_get_array_element(&v, 0)));
+    nfjson_free(&v);
+    big[4095] = '3';
+    test_parse_file_write(path, big, 4096);
+    EXPECT_EQ_INT(NFJSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, nfjson_parse_file(&v, path, NULL));
+    free(big);
+
+    test_parse_file_write(path, "", 0);
+    EXPECT_EQ_INT(NFJSON_PARSE_EXPECT_VALUE, nfjson_parse_file(&v, path, NULL));
+    remove(path);
+    EXPECT_EQ_INT(NFJSON_PARSE_IO_ERROR, nfjson_parse_file(&v, path, NULL));
+    EXPECT_EQ_INT(JSON_UNRESOLVED, nfjson_get_type(&v));
+    EXPECT_EQ_INT(NFJSON_PARSE_IO_ERROR, nfjson_parse_document_file(&doc, path, NULL));
+}
+
+static void test_parse_projected() {
+    const char *json = "{\"user\":{\"id\":7,\"name\":\"x\\ty\",\"tags\":[1,2]},\"a\\/b\":true,"
+        "\"items\":[{\"price\":1.5,\"sku\":\"a\"},{\"sku\":\"b\"},{\"price\":3,\"junk\":[[{}]]}],"
+        "\"noise\":{\"deep\":[tru,{\"x\":\"}]\\\"\"}]}}";
+    const char *fields[] = { "/user/id", "/items/*/price", "/a~1b" }, *index[] = { "/items/1/sku", "/user/id/below" };
+    const char *whole[] = { "" }, *bad[] = { "/user", "user" };
+    nfjson_projection *proj;
+    nfjson_parse_options opts = { .max_depth = 1 };
+    nfjson_document doc;
+    nfjson_value v, *user, *items;
+
+    proj = nfjson_projection_new(fields, 3);
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_projected(&v, json, strlen(json), proj, NULL));
+    EXPECT_EQ_SIZE_T(3, nfjson_get_object_size(&v));
+    user = nfjson_get_object_value(&v, &(nfjson_string) { "user", 4 });
+    EXPECT_EQ_SIZE_T(1, nfjson_get_object_size(user));
+    EXPECT_EQ_NUMBER(7.0, nfjson_get_number(nfjson_get_object_value(user, &(nfjson_string) { "id", 2 })));
+    EXPECT_EQ_INT(JSON_TRUE, nfjson_get_type(nfjson_get_object_value(&v, &(nfjson_string) { "a/b", 3 })));
+    items = nfjson_get_object_value(&v, &(nfjson_string) { "items", 5 });
+    EXPECT_EQ_SIZE_T(3, nfjson_get_array_size(items));
+    EXPECT_EQ_SIZE_T(1, nfjson_get_object_size(nfjson_get_array_element(items, 0)));
+    EXPECT_EQ_SIZE_T(0, nfjson_get_object_size(nfjson_get_array_element(items, 1)));
+    EXPECT_EQ_NUMBER(3.0, nfjson_get_number(nfjson_get_object_value(nfjson_get_array_element(items, 2), &(nfjson_string) { "price", 5 })));
+    nfjson_free(&v);
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_document_projected(&doc, json, strlen(json), proj, NULL));
+    EXPECT_EQ_SIZE_T(3, nfjson_get_object_size(&doc.root));
+    nfjson_document_free(&doc);
+    /* skipped text is only checked for string ends and bracket balance */
+    EXPECT_EQ_INT(NFJSON_PARSE_MISS_QUOTATION_MARK, nfjson_parse_projected(&v, "{\"noise\":\"x", 11, proj, NULL));
+    EXPECT_EQ_INT(NFJSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, nfjson_parse_projected(&v, "{\"noise\":[{}", 12, proj, NULL));
+    EXPECT_EQ_INT(JSON_UNRESOLVED, nfjson_get_type(&v));
+    EXPECT_EQ_INT(NFJSON_PARSE_INVALID_VALUE, nfjson_parse_projected(&v, "{\"user\":{\"id\":tru}}", 19, proj, NULL));
+    EXPECT_EQ_INT(NFJSON_EXTRA_COMMA, nfjson_parse_projected(&v, "{\"items\":[{},]}", 15, proj, NULL));
+    EXPECT_EQ_INT(NFJSON_PARSE_ROOT_NOT_SINGULAR, nfjson_parse_projected(&v, "{} x", 4, proj, NULL));
+    EXPECT_EQ_INT(NFJSON_PARSE_TOO_DEEP, nfjson_parse_projected(&v, json, strlen(json), proj, &opts));
+    nfjson_projection_free(proj);
+
+    /* arrays keep the positions off the paths */
+    proj = nfjson_projection_new(index, 2);
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_projected(&v, json, strlen(json), proj, NULL));
+    EXPECT_EQ_SIZE_T(2, nfjson_get_object_size(&v));
+    EXPECT_EQ_SIZE_T(0, nfjson_get_object_size(nfjson_get_object_value(&v, &(nfjson_string) { "user", 4 })));
+    items = nfjson_get_object_value(&v, &(nfjson_string) { "items", 5 });
+    EXPECT_EQ_SIZE_T(3, nfjson_get_array_size(items));
+    EXPECT_EQ_INT(JSON_UNRESOLVED, nfjson_get_type(nfjson_get_array_element(items, 0)));
+    EXPECT_EQ_STRING("b", nfjson_get_string(nfjson_get_object_value(nfjson_get_array_element(items, 1), &(nfjson_string) { "sku", 3 })), 1);
+    nfjson_free(&v);
+    nfjson_projection_free(proj);
+
+    proj = nfjson_projection_new(whole, 1);
+    EXPECT_EQ_INT(NFJSON_PARSE_INVALID_VALUE, nfjson_parse_projected(&v, "{\"a\":[tru]}", 12, proj, NULL));
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_projected(&v, "[1,{\"k\":null}]", 14, proj, NULL));
+    EXPECT_EQ_SIZE_T(2, nfjson_get_array_size(&v));
+    nfjson_free(&v);
+    nfjson_projection_free(proj);
+
+    EXPECT_EQ_POINTER(NULL, nfjson_projection_new(bad, 2));
+    EXPECT_EQ_POINTER(NULL, nfjson_projection_new((const char *[]) { "/~2" }, 1));
+}
+
+static void test_parse_document_strings() {
+    const char json[] = "{\"key\":\"plain\",\"k\\u0065y2\":[\"a\\tb\",\"\"]}";
+    char insitu[sizeof(json)];
+    nfjson_document doc;
+    nfjson_value *v;
+    const nfjson_string *keys[2];
+
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_document_borrowed(&doc, json, sizeof(json) - 1));
+    v = nfjson_get_object_value(&doc.root, &(nfjson_string) { "key", 3 });
+    EXPECT_EQ_STRING("plain", nfjson_get_string(v), nfjson_get_string_length(v));
+    EXPECT_TRUE(nfjson_get_string(v) >= json && nfjson_get_string(v) < json + sizeof(json));
+    v = nfjson_get_object_value(&doc.root, &(nfjson_string) { "key2", 4 });
+    EXPECT_EQ_STRING("a\tb", nfjson_get_string(nfjson_get_array_element(v, 0)), nfjson_get_string_length(nfjson_get_array_element(v, 0)));
+    EXPECT_EQ_SIZE_T(0, nfjson_get_string_length(nfjson_get_array_element(v, 1)));
+    nfjson_get_object_key(&doc.root, keys);
+    EXPECT_TRUE((keys[0]->s >= json && keys[0]->s < json + sizeof(json)) != (keys[1]->s >= json && keys[1]->s < json + sizeof(json)));
+    nfjson_document_free(&doc);
+
+    /* borrowed text runs on into the json, copied text is terminated */
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_document_borrowed(&doc, "[\"ab\",\"c\\nd\"]", 13));
+    EXPECT_EQ_SIZE_T(2, nfjson_get_string_length(nfjson_get_array_element(&doc.root, 0)));
+    EXPECT_EQ_SIZE_T(11, strlen(nfjson_get_string(nfjson_get_array_element(&doc.root, 0))));
+    EXPECT_EQ_SIZE_T(3, nfjson_get_string_length(nfjson_get_array_element(&doc.root, 1)));
+    EXPECT_EQ_SIZE_T(3, strlen(nfjson_get_string(nfjson_get_array_element(&doc.root, 1))));
+    nfjson_document_free(&doc);
+
+    memcpy(insitu, json, sizeof(json));
+    EXPECT_EQ_INT(NFJSON_PARSE_OK, nfjson_parse_document_insitu(&doc, insitu, sizeof(insitu) - 1));
+    nfjson_get_object_key(&doc.root, keys);
+    EXPECT_TRUE(keys[0]->s > insitu && keys[0]->s < insitu + sizeof(insitu) && keys[0]->s[keys[0]->len] == '\0');
+    EXPECT_TRUE(keys[1]->s > insitu && keys[1]->s < insitu + sizeof(insitu) && keys[1]->s[keys[1]->len] == '\0');
+    v = nfjson_get_object_value(&doc.root, &(nfjson_string) { "key2", 4 });
+    EXPECT_EQ_INT(0, strcmp("a\tb", nfjson_get_string(nfjson_get_array_element(v, 0))));
+    EXPECT_TRUE(nfjson_get_string(nfjson_get_array_element(v, 0)) > insitu);
+    v = nfjson_get_object_value(&doc.root, &(nfjson_string) { "key", 3 });
+    EXPECT_EQ_INT(0, strcmp("plain", nfjson_get_string(v)));
+    nfjson_document_free(&doc);
+
+    memcpy(insitu, "[\"\\u00e9\",\"x", 12);
+    EXPECT_EQ_INT(NFJSON_PARSE_MISS_QUOTATION_MARK, nfjson_parse_document_insitu(&doc, insitu, 12));
+    nfjson_document_free(&doc);
+}
+
 #define TEST_ROUNDTRIP(json)\
     do {\
         nfjson_value v;\
@@ -553,6 +1652,12 @@ static void test_stringify_number() {
     TEST_ROUNDTRIP("1e+20");
     TEST_ROUNDTRIP("1.234e+20");
     TEST_ROUNDTRIP("1.234e-20");
+    TEST_ROUNDTRIP("10");
+    TEST_ROUNDTRIP("1234567890123");
+    TEST_ROUNDTRIP("9007199254740993");
+    TEST_ROUNDTRIP("-9223372036854775808");
+    TEST_ROUNDTRIP("18446744073709551615");
+    TEST_ROUNDTRIP("[1,-20,300,{\"id\":4000000000000000001}]");
 
     TEST_ROUNDTRIP("1.0000000000000002"); /* the smallest number > 1 */
     TEST_ROUNDTRIP("4.9406564584124654e-324"); /* minimum denormal */
@@ -573,6 +1678,7 @@ static void test_stringify_string() {
     TEST_ROUNDTRIP("\"Hello\\u0000World\"");
     TEST_ROUNDTRIP("\"Hello\\u000BWorld\"");
     TEST_ROUNDTRIP("\"Hello\\u001BWorld\"");
+    TEST_ROUNDTRIP("\"\xE4\xB8\xAD\xE6\x96\x87 \\u001F abcdefghijklmnopqrstuvwxyz0123456789 \\\" end\"");
     char longstr[10002] = { 0 };
     memset(longstr, 'i' , 10000);
     longstr[0] = longstr[10000] ='\"';
@@ -586,7 +1692,9 @@ static void test_stringify_array() {
 
 static void test_stringify_object() {
     TEST_ROUNDTRIP("{}");
-    //TEST_ROUNDTRIP("{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\",\"a\":[1,2,3],\"o\":{\"1\":1,\"2\":2,\"3\":3}}");//no order guarantee
+    TEST_ROUNDTRIP("{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\",\"a\":[1,2,3],\"o\":{\"1\":1,\"2\":2,\"3\":3}}");
+    TEST_ROUNDTRIP("{\"z\":0,\"y\":1,\"x\":2,\"w\":3,\"v\":4,\"u\":5,\"t\":6,\"s\":7,\"r\":8,\"q\":9,"
+        "\"p\":10,\"o\":11,\"n\":12,\"m\":13,\"l\":14,\"k\":15,\"j\":16,\"i\":17,\"h\":18,\"g\":19}");
 }
 
 static void test_stringify_error() {
@@ -621,12 +1729,17 @@ static void test_parse() {
     test_parse_expect_value();
     test_parse_root_not_singular();
     test_parse_number();
+    test_parse_number_exact();
+    test_parse_integer();
     test_parse_number_too_big();
     test_access_string();
     test_parse_string();
+    test_parse_string_runs();
     test_parse_missing_quotation_mark();
     test_parse_invalid_string_escape();
     test_parse_invalid_string_char();
+    test_parse_invalid_utf8();
+    test_utf8_kernels();
     test_access_null();
     test_access_boolean();
     test_access_number();
@@ -635,14 +1748,34 @@ static void test_parse() {
     test_parse_array();
     test_parse_array_extra_comma();
     test_parse_miss_comma_or_square_bracket();
-    #if 0
     test_hash_table_char_key();
+    test_hash_table_churn();
+    test_hash_table_incremental();
+    test_hash_table_bulk();
+    test_hash_table_flood();
+    #if 0
     test_hash_table_nfjson_string_key();
     #endif
     test_parse_miss_key();
     test_parse_miss_colon();
     test_parse_miss_comma_or_curly_bracket();
     test_parse_object();
+    test_parse_object_members();
+    test_parse_object_key();
+    test_parse_depth();
+    test_parse_document();
+    test_parse_document_lazy();
+    test_parse_document_strings();
+    test_parse_n();
+    test_parse_whitespace_runs();
+    test_parse_stream();
+    test_parse_sax();
+    test_parse_reader();
+    test_parse_ndjson();
+    test_parse_parallel();
+    test_parse_reuse();
+    test_parse_file();
+    test_parse_projected();
     test_stringify();
 }
 
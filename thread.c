@@ -0,0 +1,183 @@
+#include"pch.h"
+#include"thread.h"
+#if defined(_WIN32)
+#include<windows.h>
+typedef HANDLE nfjson_thread;
+typedef CRITICAL_SECTION nfjson_mutex;
+typedef CONDITION_VARIABLE nfjson_cond;
+#define nfjson_mutex_init(m) InitializeCriticalSection(m)
+#define nfjson_mutex_destroy(m) DeleteCriticalSection(m)
+#define nfjson_mutex_lock(m) EnterCriticalSection(m)
+#define nfjson_mutex_unlock(m) LeaveCriticalSection(m)
+#define nfjson_cond_init(cv) InitializeConditionVariable(cv)
+#define nfjson_cond_destroy(cv) ((void)0)
+#define nfjson_cond_wait(cv, m) SleepConditionVariableCS(cv, m, INFINITE)
+#define nfjson_cond_signal(cv) WakeConditionVariable(cv)
+#define nfjson_cond_broadcast(cv) WakeAllConditionVariable(cv)
+#else
+#include<pthread.h>
+#include<unistd.h>
+typedef pthread_t nfjson_thread;
+typedef pthread_mutex_t nfjson_mutex;
+typedef pthread_cond_t nfjson_cond;
+#define nfjson_mutex_init(m) pthread_mutex_init(m, NULL)
+#define nfjson_mutex_destroy(m) pthread_mutex_destroy(m)
+#define nfjson_mutex_lock(m) pthread_mutex_lock(m)
+#define nfjson_mutex_unlock(m) pthread_mutex_unlock(m)
+#define nfjson_cond_init(cv) pthread_cond_init(cv, NULL)
+#define nfjson_cond_destroy(cv) pthread_cond_destroy(cv)
+#define nfjson_cond_wait(cv, m) pthread_cond_wait(cv, m)
+#define nfjson_cond_signal(cv) pthread_cond_signal(cv)
+#define nfjson_cond_broadcast(cv) pthread_cond_broadcast(cv)
+#endif
+
+typedef struct {
+    nfjson_pool *pool;
+    unsigned id;
+}nfjson_worker;
+
+struct nfjson_pool {
+    unsigned count;/*workers, the caller of nfjson_pool_run is worker 0*/
+    nfjson_thread *threads;/*workers 1 .. count - 1*/
+    nfjson_worker *workers;
+    nfjson_mutex lock;
+    nfjson_cond wake;/*a run started or the pool is closing*/
+    nfjson_cond done;/*the last worker of a run returned*/
+    void (*fn)(void *arg, unsigned worker);
+    void *arg;
+    size_t run;/*runs started so far*/
+    unsigned pending;/*workers of the current run still busy*/
+    int quit;
+};
+
+static unsigned nfjson_cpu_count(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (unsigned)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 1;
+#endif
+}
+
+static void nfjson_worker_loop(nfjson_worker *w) {
+    nfjson_pool *pool = w->pool;
+    size_t seen = 0;
+    void (*fn)(void *arg, unsigned worker);
+    void *arg;
+    for (;;) {
+        nfjson_mutex_lock(&pool->lock);
+        while (!pool->quit && pool->run == seen) nfjson_cond_wait(&pool->wake, &pool->lock);
+        if (pool->quit) {
+            nfjson_mutex_unlock(&pool->lock);
+            return;
+        }
+        seen = pool->run;
+        fn = pool->fn;
+        arg = pool->arg;
+        nfjson_mutex_unlock(&pool->lock);
+        fn(arg, w->id);
+        nfjson_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) nfjson_cond_signal(&pool->done);
+        nfjson_mutex_unlock(&pool->lock);
+    }
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI nfjson_worker_main(LPVOID w) {
+    nfjson_worker_loop((nfjson_worker *)w);
+    return 0;
+}
+#else
+static void *nfjson_worker_main(void *w) {
+    nfjson_worker_loop((nfjson_worker *)w);
+    return NULL;
+}
+#endif
+
+nfjson_pool *nfjson_pool_new(unsigned threads) {
+    nfjson_pool *pool = (nfjson_pool *)malloc(sizeof(nfjson_pool));
+    unsigned i;
+    if (threads == 0) threads = nfjson_cpu_count();
+    pool->count = threads;
+    pool->threads = (nfjson_thread *)malloc(sizeof(nfjson_thread) * threads);
+    pool->workers = (nfjson_worker *)malloc(sizeof(nfjson_worker) * threads);
+    nfjson_mutex_init(&pool->lock);
+    nfjson_cond_init(&pool->wake);
+    nfjson_cond_init(&pool->done);
+    pool->fn = NULL;
+    pool->arg = NULL;
+    pool->run = 0;
+    pool->pending = 0;
+    pool->quit = 0;
+    for (i = 1; i < threads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+#if defined(_WIN32)
+        pool->threads[i] = CreateThread(NULL, 0, nfjson_worker_main, pool->workers + i, 0, NULL);
+        if (pool->threads[i] == NULL) break;
+#else
+        if (pthread_create(pool->threads + i, NULL, nfjson_worker_main, pool->workers + i) != 0) break;
+#endif
+    }
+    pool->count = i;//the threads that did start
+    return pool;
+}
+
+void nfjson_pool_free(nfjson_pool *pool) {
+    unsigned i;
+    if (pool == NULL) return;
+    nfjson_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    nfjson_cond_broadcast(&pool->wake);
+    nfjson_mutex_unlock(&pool->lock);
+    for (i = 1; i < pool->count; i++) {
+#if defined(_WIN32)
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+#else
+        pthread_join(pool->threads[i], NULL);
+#endif
+    }
+    nfjson_cond_destroy(&pool->done);
+    nfjson_cond_destroy(&pool->wake);
+    nfjson_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+}
+
+unsigned nfjson_pool_size(const nfjson_pool *pool) {
+    return pool ? pool->count : 1;
+}
+
+/* a NULL pool runs fn on the caller alone */
+void nfjson_pool_run(nfjson_pool *pool, void (*fn)(void *arg, unsigned worker), void *arg) {
+    assert(NULL != fn);
+    if (pool == NULL || pool->count == 1) {
+        fn(arg, 0);
+        return;
+    }
+    nfjson_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->pending = pool->count - 1;
+    pool->run++;
+    nfjson_cond_broadcast(&pool->wake);
+    nfjson_mutex_unlock(&pool->lock);
+    fn(arg, 0);
+    nfjson_mutex_lock(&pool->lock);
+    while (pool->pending) nfjson_cond_wait(&pool->done, &pool->lock);
+    nfjson_mutex_unlock(&pool->lock);
+}
+
+size_t nfjson_atomic_fetch_add(volatile size_t *p, size_t v) {
+#if defined(_WIN64)
+    return (size_t)InterlockedExchangeAdd64((volatile LONG64 *)p, (LONG64)v);
+#elif defined(_WIN32)
+    return (size_t)InterlockedExchangeAdd((volatile LONG *)p, (LONG)v);
+#else
+    return __atomic_fetch_add(p, v, __ATOMIC_ACQ_REL);
+#endif
+}
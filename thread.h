@@ -0,0 +1,22 @@
+#pragma once
+#include"pch.h"
+
+/**
+*   fork-join worker pool. nfjson_pool_run calls fn once on every worker,
+*   the calling thread being worker 0, and returns when all calls have
+*   returned. threads are created once and sleep between runs.
+**/
+typedef struct nfjson_pool nfjson_pool;
+
+/* threads == 0 takes one worker per online processor */
+nfjson_pool *nfjson_pool_new(unsigned threads);
+
+void nfjson_pool_free(nfjson_pool *pool);
+
+/* workers of a run, the calling thread included */
+unsigned nfjson_pool_size(const nfjson_pool *pool);
+
+void nfjson_pool_run(nfjson_pool *pool, void (*fn)(void *arg, unsigned worker), void *arg);
+
+/* old *p, for work counters shared by the workers of a run */
+size_t nfjson_atomic_fetch_add(volatile size_t *p, size_t v);
@@ -0,0 +1,261 @@
+#include"pch.h"
+#include"utf8.h"
+#include"simd.h"
+#if defined(_WIN32)
+#include<windows.h>
+#endif
+
+/**
+*   on x86 the SSSE3 and AVX2 kernels are built whatever the compiler
+*   targets, GCC and Clang through target attributes, and the first call
+*   picks one from cpuid. elsewhere only what the compiler targets is built
+**/
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) || defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define NFJSON_UTF8_DISPATCH
+#include<immintrin.h>
+#endif
+#if defined(NFJSON_UTF8_DISPATCH) && defined(__GNUC__)
+#define NFJSON_UTF8_TARGET(isa) __attribute__((target(isa)))
+#else
+#define NFJSON_UTF8_TARGET(isa)
+#endif
+#if defined(NFJSON_AVX2) || defined(NFJSON_UTF8_DISPATCH)
+#define NFJSON_UTF8_AVX2_KERNEL
+#endif
+#if defined(NFJSON_SSSE3) || defined(NFJSON_UTF8_DISPATCH)
+#define NFJSON_UTF8_SSSE3_KERNEL
+#endif
+
+/**
+*   the vector kernels follow Keiser and Lemire, "Validating UTF-8 In Less
+*   Than One Instruction Per Byte": three 16-entry tables looked up by the
+*   nibbles of each byte and of the byte before it flag every error one or
+*   two bytes long, the bytes two and three back tell where a continuation
+*   must be. every error leaves a bit set in the block
+**/
+#define UTF8_TOO_SHORT      (1 << 0)/* lead or ASCII, then a lead */
+#define UTF8_TOO_LONG       (1 << 1)/* ASCII, then a continuation */
+#define UTF8_OVERLONG_3     (1 << 2)/* 11100000 100_____ */
+#define UTF8_TOO_LARGE      (1 << 3)/* above U+10FFFF */
+#define UTF8_SURROGATE      (1 << 4)/* 11101101 101_____ */
+#define UTF8_OVERLONG_2     (1 << 5)/* 1100000_ 10______ */
+#define UTF8_TOO_LARGE_1000 (1 << 6)/* 11110100 1000____ and above */
+#define UTF8_OVERLONG_4     (1 << 6)/* 11110000 1000____ */
+#define UTF8_TWO_CONTS      (1 << 7)/* continuation, then a continuation */
+#define UTF8_CARRY          (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+/* by the high nibble of the previous byte */
+#define UTF8_BYTE_1_HIGH \
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, \
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, \
+    UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, \
+    UTF8_TOO_SHORT | UTF8_OVERLONG_2, \
+    UTF8_TOO_SHORT, \
+    UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE, \
+    UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+/* by the low nibble of the previous byte */
+#define UTF8_BYTE_1_LOW \
+    UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4, \
+    UTF8_CARRY | UTF8_OVERLONG_2, \
+    UTF8_CARRY, UTF8_CARRY, \
+    UTF8_CARRY | UTF8_TOO_LARGE, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+/* by the high nibble of the byte itself */
+#define UTF8_BYTE_2_HIGH \
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, \
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4, \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE, \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE, \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE, \
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+
+/* the table of well-formed byte sequences in RFC 3629 section 4 */
+static int nfjson_utf8_check_scalar(const char *str, const char *end) {
+    const unsigned char *s = (const unsigned char *)str, *e = (const unsigned char *)end;
+    unsigned char lo, hi;
+    size_t n;
+    while (s < e) {
+        if (*s < 0x80) { s++; continue; }
+        lo = 0x80;
+        hi = 0xBF;
+        if (*s >= 0xC2 && *s <= 0xDF) n = 1;
+        else if (*s >= 0xE0 && *s <= 0xEF) {
+            n = 2;
+            if (*s == 0xE0) lo = 0xA0;
+            else if (*s == 0xED) hi = 0x9F;
+        }
+        else if (*s >= 0xF0 && *s <= 0xF4) {
+            n = 3;
+            if (*s == 0xF0) lo = 0x90;
+            else if (*s == 0xF4) hi = 0x8F;
+        }
+        else return 0;
+        if ((size_t)(e - ++s) < n || *s < lo || *s > hi) return 0;
+        for (s++; --n; s++) if (*s < 0x80 || *s > 0xBF) return 0;
+    }
+    return 1;
+}
+
+#if defined(NFJSON_UTF8_AVX2_KERNEL) || defined(NFJSON_UTF8_SSSE3_KERNEL)
+/**
+*   the blocks checked every sequence starting in them but not whether the
+*   last one is complete. the bytes after them go to the scalar check from
+*   the lead of that sequence on, at most three bytes back
+**/
+static int nfjson_utf8_check_tail(const char *begin, const char *s, const char *end) {
+    const char *lead = s;
+    while (lead > begin && s - lead < 3 && ((unsigned char)lead[-1] & 0xC0) == 0x80) lead--;
+    if (lead > begin && (unsigned char)lead[-1] >= 0xC0) lead--;
+    return nfjson_utf8_check_scalar(lead, end);
+}
+#endif
+
+#if defined(NFJSON_UTF8_AVX2_KERNEL)
+NFJSON_UTF8_TARGET("avx2")
+static int nfjson_utf8_check_avx2(const char *s, const char *end) {
+    const char *begin = s;
+    int valid;
+    const __m256i byte_1_high = _mm256_setr_epi8(UTF8_BYTE_1_HIGH, UTF8_BYTE_1_HIGH);
+    const __m256i byte_1_low = _mm256_setr_epi8(UTF8_BYTE_1_LOW, UTF8_BYTE_1_LOW);
+    const __m256i byte_2_high = _mm256_setr_epi8(UTF8_BYTE_2_HIGH, UTF8_BYTE_2_HIGH);
+    const __m256i nibble = _mm256_set1_epi8(0x0F), high = _mm256_set1_epi8((char)0x80);
+    const __m256i third = _mm256_set1_epi8(0xE0 - 0x80), fourth = _mm256_set1_epi8((char)(0xF0 - 0x80));
+    const __m256i max = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                         -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)0xEF, (char)0xDF, (char)0xBF);
+    __m256i prev = _mm256_setzero_si256(), error = _mm256_setzero_si256(), incomplete = _mm256_setzero_si256();
+    for (; end - s >= 32; s += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i *)s), shifted, prev1, sc;
+        if (!_mm256_movemask_epi8(input)) {//an ASCII block only has to see the last sequence complete
+            error = _mm256_or_si256(error, incomplete);
+            incomplete = _mm256_setzero_si256();
+            prev = input;
+            continue;
+        }
+        shifted = _mm256_permute2x128_si256(prev, input, 0x21);//the high half of prev, then the low half of input
+        prev1 = _mm256_alignr_epi8(input, shifted, 15);
+        sc = _mm256_and_si256(_mm256_and_si256(
+            _mm256_shuffle_epi8(byte_1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+            _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, nibble))),
+            _mm256_shuffle_epi8(byte_2_high, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+        error = _mm256_or_si256(error, _mm256_xor_si256(sc, _mm256_and_si256(high, _mm256_or_si256(
+            _mm256_subs_epu8(_mm256_alignr_epi8(input, shifted, 14), third),
+            _mm256_subs_epu8(_mm256_alignr_epi8(input, shifted, 13), fourth)))));
+        incomplete = _mm256_subs_epu8(input, max);//a lead too close to the end
+        prev = input;
+    }
+    valid = _mm256_testz_si256(error, error);
+    _mm256_zeroupper();//the tail and the caller may be plain SSE code
+    return valid && nfjson_utf8_check_tail(begin, s, end);
+}
+#endif
+
+#if defined(NFJSON_UTF8_SSSE3_KERNEL)
+NFJSON_UTF8_TARGET("ssse3")
+static int nfjson_utf8_check_ssse3(const char *s, const char *end) {
+    const char *begin = s;
+    const __m128i byte_1_high = _mm_setr_epi8(UTF8_BYTE_1_HIGH);
+    const __m128i byte_1_low = _mm_setr_epi8(UTF8_BYTE_1_LOW);
+    const __m128i byte_2_high = _mm_setr_epi8(UTF8_BYTE_2_HIGH);
+    const __m128i nibble = _mm_set1_epi8(0x0F), high = _mm_set1_epi8((char)0x80);
+    const __m128i third = _mm_set1_epi8(0xE0 - 0x80), fourth = _mm_set1_epi8((char)(0xF0 - 0x80));
+    const __m128i max = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)0xEF, (char)0xDF, (char)0xBF);
+    __m128i prev = _mm_setzero_si128(), error = _mm_setzero_si128(), incomplete = _mm_setzero_si128();
+    for (; end - s >= 16; s += 16) {
+        __m128i input = _mm_loadu_si128((const __m128i *)s), prev1, sc;
+        if (!_mm_movemask_epi8(input)) {//an ASCII block only has to see the last sequence complete
+            error = _mm_or_si128(error, incomplete);
+            incomplete = _mm_setzero_si128();
+            prev = input;
+            continue;
+        }
+        prev1 = _mm_alignr_epi8(input, prev, 15);
+        sc = _mm_and_si128(_mm_and_si128(
+            _mm_shuffle_epi8(byte_1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+            _mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, nibble))),
+            _mm_shuffle_epi8(byte_2_high, _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+        error = _mm_or_si128(error, _mm_xor_si128(sc, _mm_and_si128(high, _mm_or_si128(
+            _mm_subs_epu8(_mm_alignr_epi8(input, prev, 14), third),
+            _mm_subs_epu8(_mm_alignr_epi8(input, prev, 13), fourth)))));
+        incomplete = _mm_subs_epu8(input, max);//a lead too close to the end
+        prev = input;
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF && nfjson_utf8_check_tail(begin, s, end);
+}
+#endif
+
+static int nfjson_utf8_cpu(void) {
+#if defined(NFJSON_AVX2)
+    return NFJSON_UTF8_AVX2;
+#elif defined(NFJSON_UTF8_DISPATCH) && defined(_MSC_VER)
+    int info[4], max, ecx;
+    __cpuid(info, 0);
+    max = info[0];
+    __cpuid(info, 1);
+    ecx = info[2];
+    if (max >= 7 && (ecx & (1 << 27)) && (ecx & (1 << 28)) && (_xgetbv(0) & 6) == 6) {//AVX, and the OS saves the ymm registers
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5)) return NFJSON_UTF8_AVX2;
+    }
+    return ecx & (1 << 9) ? NFJSON_UTF8_SSSE3 : NFJSON_UTF8_SCALAR;
+#elif defined(NFJSON_UTF8_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return NFJSON_UTF8_AVX2;
+    return __builtin_cpu_supports("ssse3") ? NFJSON_UTF8_SSSE3 : NFJSON_UTF8_SCALAR;
+#elif defined(NFJSON_SSSE3)
+    return NFJSON_UTF8_SSSE3;
+#else
+    return NFJSON_UTF8_SCALAR;
+#endif
+}
+
+/* 0 until the first call, threads racing to it store the same value */
+static int nfjson_utf8_best;
+
+int nfjson_utf8_kernel(void) {
+#if defined(_WIN32)
+    int kernel = (int)InterlockedCompareExchange((volatile LONG *)&nfjson_utf8_best, 0, 0);
+    if (!kernel) InterlockedExchange((volatile LONG *)&nfjson_utf8_best, kernel = nfjson_utf8_cpu());
+#else
+    int kernel = __atomic_load_n(&nfjson_utf8_best, __ATOMIC_RELAXED);
+    if (!kernel) __atomic_store_n(&nfjson_utf8_best, kernel = nfjson_utf8_cpu(), __ATOMIC_RELAXED);
+#endif
+    return kernel;
+}
+
+static int nfjson_utf8_check(int kernel, const char *s, const char *end) {
+#if defined(NFJSON_UTF8_AVX2_KERNEL)
+    if (kernel == NFJSON_UTF8_AVX2) return nfjson_utf8_check_avx2(s, end);
+#endif
+#if defined(NFJSON_UTF8_SSSE3_KERNEL)
+    if (kernel == NFJSON_UTF8_SSSE3) return nfjson_utf8_check_ssse3(s, end);
+#endif
+    (void)kernel;
+    return nfjson_utf8_check_scalar(s, end);
+}
+
+int nfjson_utf8_valid_kernel(int kernel, const char *s, size_t len) {
+    const char *end = s + len;
+    uint64_t w;
+    assert(kernel >= NFJSON_UTF8_SCALAR && kernel <= nfjson_utf8_kernel());
+    for (; end - s >= 8; s += 8) {//ASCII runs, most strings, return here
+        memcpy(&w, s, 8);
+        if (w & 0x8080808080808080ULL) break;
+    }
+    while (s < end && !(*s & 0x80)) s++;
+    return s == end || nfjson_utf8_check(kernel, s, end);
+}
+
+int nfjson_utf8_valid(const char *s, size_t len) {
+    return nfjson_utf8_valid_kernel(nfjson_utf8_kernel(), s, len);
+}
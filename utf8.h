@@ -0,0 +1,22 @@
+#pragma once
+#include"pch.h"
+
+/**
+*   nonzero when [s, s + len) is well-formed UTF-8 (RFC 3629): no overlong
+*   forms, no surrogates, nothing above U+10FFFF, no stray or missing
+*   continuation bytes
+**/
+int nfjson_utf8_valid(const char *s, size_t len);
+
+/* the checks nfjson_utf8_valid can run, a higher one is faster */
+enum {
+    NFJSON_UTF8_SCALAR = 1,
+    NFJSON_UTF8_SSSE3,
+    NFJSON_UTF8_AVX2
+};
+
+/* the highest check this build can run on this CPU, the one nfjson_utf8_valid runs */
+int nfjson_utf8_kernel(void);
+
+/* nfjson_utf8_valid through one check no higher than nfjson_utf8_kernel(), for tests */
+int nfjson_utf8_valid_kernel(int kernel, const char *s, size_t len);